@@ -0,0 +1,20 @@
+#
+# Write the log token dictionary of a LOG_TOKENIZED build next to the firmware
+# (decode with: buildroot/share/scripts/mmu_log_tokens.py decode <dictionary> <capture>)
+#
+import json
+import os
+import sys
+Import("env")
+
+sys.path.insert(0, os.path.join(env.subst("$PROJECT_DIR"), "buildroot", "share", "scripts"))
+import mmu_log_tokens
+
+def write_dictionary(source, target, env):
+    tokens = mmu_log_tokens.build_dictionary(env.subst("$PROJECT_SRC_DIR"))
+    path = os.path.join(env.subst("$BUILD_DIR"), "log_tokens.json")
+    with open(path, "w") as f:
+        json.dump(tokens, f, indent=1, sort_keys=True)
+    print("%d log tokens written to %s" % (len(tokens), path))
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", write_dictionary)
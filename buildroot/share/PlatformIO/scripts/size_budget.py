@@ -0,0 +1,42 @@
+#
+# Fail the build when the firmware goes over its RAM / flash budget
+#
+# Budgets (bytes) are set per env in platformio.ini:
+#   custom_ram_budget   = .data + .bss
+#   custom_flash_budget = everything loaded in flash (.text, .rodata, .data init values, vectors)
+#
+import subprocess
+import sys
+Import("env")
+
+RAM_SECTIONS = (".data", ".bss", ".noinit")
+FLASH_SECTIONS = (".text", ".data", ".rodata", ".isr_vector", ".ARM.extab", ".ARM.exidx", ".preinit_array", ".init_array", ".fini_array")
+
+def section_sizes(elf):
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+    sizes = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+def check_budget(source, target, env):
+    sizes = section_sizes(target[0].get_abspath())
+    used = {
+        "ram": sum(sizes.get(s, 0) for s in RAM_SECTIONS),
+        "flash": sum(sizes.get(s, 0) for s in FLASH_SECTIONS),
+    }
+    failed = False
+    for name in ("ram", "flash"):
+        budget = env.GetProjectOption("custom_%s_budget" % name, "")
+        if not budget:
+            continue
+        budget = int(budget)
+        print("%s: %d / %d bytes (%.1f%%)" % (name.upper(), used[name], budget, 100.0 * used[name] / budget))
+        if used[name] > budget:
+            sys.stderr.write("Error: %s usage is %d bytes over budget\n" % (name, used[name] - budget))
+            failed = True
+    return 1 if failed else 0
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_budget)
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+""" Tool-change latency benchmark, runs the firmware in the MMU simulator (pio run -e sim).
+
+  mmu_bench.py [--sim program] [--baseline file] [--threshold percent]
+      run the benchmark matrix and compare every metric with the baseline,
+      exits with status 1 if one of them is slower by more than the threshold
+
+  mmu_bench.py --update
+      run the matrix and store the results as the new baseline
+
+  --cal NAME=VALUE / --set NAME=VALUE are passed to the simulator, to see what a
+  calibration change (or a different machine) does to the numbers
+
+The matrix:
+  swap a-b     T<a> C0 then T<b> C0 from a cold boot, metrics of the second swap
+               (total, unload / select / feed phases, and the C0 that follows)
+  U<n>, L<n>   unload after T<n> C0, load to the FINDA from a cold boot
+  boot cold    no EEPROM record, the axes are homed
+  boot warm    after a clean shutdown, the positions are restored
+
+All times are virtual seconds on the modelled machine, a run is deterministic.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+DEFAULT_SIM = os.path.join(ROOT, '.pio', 'build', 'sim', 'program')
+DEFAULT_BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'mmu_bench_baseline.json')
+SLOTS = range(5)
+PHASES = ('unload', 'select', 'feed', 'c')
+MIN_DELTA = 0.001  # s, below this a difference is rounding
+SIM_ARGS = []  # --cal / --set given on the command line
+
+
+def simulate(sim, commands, workdir=None, extra=()):
+    args = [sim, '--json', '--commands', ' '.join(commands)] + list(extra) + SIM_ARGS
+    if workdir:
+        args += ['--eeprom', os.path.join(workdir, 'eeprom.bin'), '--state', os.path.join(workdir, 'state.txt')]
+    result = subprocess.run(args, stdout=subprocess.PIPE, universal_newlines=True)
+    report = json.loads(result.stdout)
+    if report['timed_out'] or result.returncode:
+        raise RuntimeError('simulation failed: %s' % ' '.join(commands))
+    return report
+
+
+def command(report, index):
+    # the handshake (S1, S2, P0) comes first
+    return report['commands'][3 + index]
+
+
+def run_matrix(sim):
+    metrics = {}
+    for a in SLOTS:
+        for b in SLOTS:
+            if a == b:
+                continue
+            report = simulate(sim, ['T%d' % a, 'C0', 'T%d' % b, 'C0'])
+            swap, load = command(report, 2), command(report, 3)
+            name = 'swap %d-%d' % (a, b)
+            metrics[name] = swap['seconds']
+            for phase in PHASES[:3]:
+                metrics['%s %s' % (name, phase)] = swap['phases_s'][phase]
+            metrics['%s C0' % name] = load['seconds']
+    for n in SLOTS:
+        report = simulate(sim, ['T%d' % n, 'C0', 'U%d' % n])
+        metrics['U%d' % n] = command(report, 2)['seconds']
+        report = simulate(sim, ['L%d' % n])
+        metrics['L%d' % n] = command(report, 0)['seconds']
+    with tempfile.TemporaryDirectory() as workdir:
+        metrics['boot cold'] = simulate(sim, ['T1', 'C0'], workdir)['boot_s']
+        metrics['boot warm'] = simulate(sim, ['T2', 'C0'], workdir)['boot_s']
+    metrics['matrix total'] = sum(v for k, v in metrics.items() if k.startswith('swap') and k.count(' ') == 1)
+    return metrics
+
+
+def compare(metrics, baseline, threshold):
+    regressions = []
+    print('%-22s %10s %10s %8s' % ('metric', 'baseline', 'now', 'change'))
+    for name in sorted(metrics):
+        now = metrics[name]
+        before = baseline.get(name)
+        if before is None:
+            print('%-22s %10s %10.3f %8s' % (name, '-', now, 'new'))
+            continue
+        change = (now - before) / before * 100 if before else 0.0
+        flag = ''
+        if (now - before > MIN_DELTA) and (change > threshold):
+            flag = '  REGRESSION'
+            regressions.append(name)
+        print('%-22s %10.3f %10.3f %+7.1f%%%s' % (name, before, now, change, flag))
+    for name in sorted(set(baseline) - set(metrics)):
+        print('%-22s %10.3f %10s %8s' % (name, baseline[name], '-', 'gone'))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--sim', default=DEFAULT_SIM, help='simulator program (default: %(default)s)')
+    parser.add_argument('--baseline', default=DEFAULT_BASELINE, help='baseline file (default: %(default)s)')
+    parser.add_argument('--threshold', type=float, default=2.0, help='allowed slowdown in percent (default: %(default)s)')
+    parser.add_argument('--update', action='store_true', help='store the results as the new baseline')
+    parser.add_argument('--cal', action='append', default=[], metavar='NAME=VALUE', help='calibration value to try (see mmu-sim --cal)')
+    parser.add_argument('--set', action='append', default=[], metavar='NAME=VALUE', help='model parameter (see mmu-sim --params)')
+    args = parser.parse_args()
+
+    for value in args.cal:
+        SIM_ARGS.extend(['--cal', value])
+    for value in args.set:
+        SIM_ARGS.extend(['--set', value])
+
+    if not os.path.exists(args.sim):
+        sys.exit('%s not found, build it with: pio run -e sim' % args.sim)
+    metrics = run_matrix(args.sim)
+
+    if args.update:
+        with open(args.baseline, 'w') as f:
+            json.dump({k: round(v, 6) for k, v in metrics.items()}, f, indent=1, sort_keys=True)
+            f.write('\n')
+        print('%d metrics written to %s' % (len(metrics), args.baseline))
+        return
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    regressions = compare(metrics, baseline, args.threshold)
+    if regressions:
+        print('\n%d metric(s) slower than the baseline by more than %.1f%%: %s' % (len(regressions), args.threshold, ', '.join(regressions)))
+        sys.exit(1)
+    print('\nno regression (threshold %.1f%%)' % args.threshold)
+
+
+if __name__ == '__main__':
+    main()
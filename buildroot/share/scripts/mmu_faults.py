@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+
+""" Fault-injection campaign: how fast the firmware detects a fault, and whether it copes on its own.
+
+  mmu_faults.py [--runs N] [--jobs N] [--seed N] [--kind KIND ...] [--operator S] [--csv file]
+
+Runs the firmware in the simulator (pio run -e sim) on a fixed workload, once
+clean and then --runs times with one fault each (mmu-sim --fault), drawn at
+random: kind, start within the clean run, duration and strength:
+
+  finda_stuck     the FINDA keeps the level it had
+  slip            a fraction of the extruder steps do not move the filament
+  selector_loss   a fraction of the selector steps are lost
+  switch_bounce   filament switch reads are wrong with some probability
+  serial_drop     Serial1 bytes are lost, both directions
+
+The printer side uses Marlin's 45 s command timeout, the operator answers
+fixTheProblem() after --operator seconds. Each run ends as one of:
+
+  no effect       the fault did not touch anything (e.g. a slip while idle)
+  recovered       all commands acknowledged, no operator, no damage
+  operator        fixTheProblem() waited for the operator, then the job went on
+  printer timeout a command was not acknowledged in time: Marlin pauses the print,
+                  also when the operator is still on the way (--operator)
+  silent          acknowledged without complaint, but the model shows a jam or slip
+
+Detection time is from the fault start to the firmware counting the failure
+(10 ms resolution), or to Marlin's timeout when the firmware did not notice.
+"""
+
+import argparse
+import csv
+import json
+import multiprocessing
+import os
+import random
+import statistics
+import subprocess
+import sys
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+DEFAULT_SIM = os.path.join(ROOT, '.pio', 'build', 'sim', 'program')
+
+WORKLOAD = 'T1 C0 T2 C0 T3 C0 U3'
+MARLIN_TIMEOUT = 45  # s, MMU_CMD_TIMEOUT
+
+# duration range (s), strength range (None: the kind's own default)
+KINDS = {
+    'finda_stuck': ((0.05, 30), None),
+    'slip': ((0.1, 20), (0.2, 1.0)),
+    'selector_loss': ((0.1, 20), (0.05, 0.8)),
+    'switch_bounce': ((0.01, 2), (0.05, 0.5)),
+    'serial_drop': ((0.05, 5), (0.01, 0.3)),
+}
+
+# stats.h STATS_FAIL_xxx
+FAILURES = ['selector blocked', 'load: FINDA', 'unload: extruder', 'unload: bowden', 'feed: FINDA',
+            'switch stuck', 'feed: extruder', 'C: extruder']
+
+OUTCOMES = ['no effect', 'recovered', 'operator', 'printer timeout', 'silent']
+
+
+def simulate(sim, extra):
+    args = [sim, '--json', '--commands', WORKLOAD, '--timeout', str(MARLIN_TIMEOUT)] + extra
+    result = subprocess.run(args, stdout=subprocess.PIPE, universal_newlines=True)
+    return json.loads(result.stdout)
+
+
+def classify(report, clean, kind):
+    model = report['model']
+    fault = report['faults'][0]
+    failures = [p for p in report['problems'] if p['start_s'] >= fault['start_s']]
+    detection = None
+    caught = None
+    if failures:
+        detection = failures[0]['start_s'] - fault['start_s']
+        caught = FAILURES[failures[0]['failure']]
+    elif report['timed_out']:
+        late = [c for c in report['commands'] if not c['acked']]
+        if late:
+            detection = late[0]['start_s'] + MARLIN_TIMEOUT - fault['start_s']
+            caught = 'Marlin timeout'
+
+    damaged = (model['jams'] > clean['model']['jams']) or (model['slips'] > clean['model']['slips'])
+    if report['timed_out']:
+        outcome = 'printer timeout'
+    elif report['operator_calls']:
+        outcome = 'operator'
+    elif damaged:
+        outcome = 'silent'
+    elif model['faulted'] == 0 and kind != 'finda_stuck' and not failures:
+        outcome = 'no effect'
+    else:
+        outcome = 'recovered'
+    lost = None if report['timed_out'] else report['total_s'] - clean['total_s']
+    return outcome, detection, caught, lost
+
+
+def run(job):
+    sim, clean, number, seed, kinds, operator, limit = job
+    rng = random.Random(seed * 1000003 + number)
+    kind = rng.choice(kinds)
+    (low, high), strength = KINDS[kind]
+    start = rng.uniform(clean['boot_s'], clean['boot_s'] + clean['total_s'])
+    duration = rng.uniform(low, high)
+    spec = '%s:%.6f:%.6f' % (kind, start, duration)
+    if strength:
+        spec += ':%.4f' % rng.uniform(*strength)
+    report = simulate(sim, ['--fault', spec, '--seed', str(rng.randrange(1, 1 << 31)),
+                            '--operator', str(operator), '--limit', str(limit)])
+    return (spec,) + classify(report, clean, kind)
+
+
+def describe(values):
+    if not values:
+        return '%8s %8s %8s' % ('-', '-', '-')
+    values = sorted(values)
+    p95 = values[min(len(values) - 1, int(round(0.95 * (len(values) - 1))))]
+    return '%8.2f %8.2f %8.2f' % (statistics.median(values), p95, values[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--sim', default=DEFAULT_SIM, help='simulator program (default: %(default)s)')
+    parser.add_argument('--runs', type=int, default=1000, help='number of faulty runs (default: %(default)s)')
+    parser.add_argument('--jobs', type=int, default=multiprocessing.cpu_count(), help='parallel simulations (default: all cores)')
+    parser.add_argument('--seed', type=int, default=1, help='random seed (default: %(default)s)')
+    parser.add_argument('--kind', action='append', choices=sorted(KINDS), help='only these faults (default: all)')
+    parser.add_argument('--operator', type=float, default=30, help='seconds the operator takes to answer (default: %(default)s)')
+    parser.add_argument('--csv', help='write every run to this file')
+    args = parser.parse_args()
+
+    if not os.path.exists(args.sim):
+        sys.exit('%s not found, build it with: pio run -e sim' % args.sim)
+    clean = simulate(args.sim, [])
+    if clean['timed_out'] or clean['operator_calls']:
+        sys.exit('the workload fails without a fault: %s' % WORKLOAD)
+    # room for every command to time out or wait for the operator once
+    limit = clean['virtual_s'] + (len(WORKLOAD.split()) + 3) * (MARLIN_TIMEOUT + args.operator)
+
+    kinds = sorted(args.kind or KINDS)
+    jobs = [(args.sim, clean, n, args.seed, kinds, args.operator, limit) for n in range(args.runs)]
+    with multiprocessing.Pool(args.jobs) as pool:
+        results = pool.map(run, jobs, chunksize=4)
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(['fault', 'outcome', 'detection_s', 'caught_by', 'lost_s'])
+            for row in results:
+                writer.writerow(['' if value is None else value for value in row])
+
+    print('workload "%s": %.1f s clean, %d runs on %d cores, operator answers after %.0f s\n' %
+          (WORKLOAD, clean['total_s'], len(results), args.jobs, args.operator))
+    print('%-14s %5s  %s  %26s  %s' % ('fault', 'runs', '  '.join('%9s' % o[:9] for o in OUTCOMES),
+                                      'detection s: median  p95  max', 'lost s (mean)'))
+    for kind in kinds:
+        rows = [r for r in results if r[0].startswith(kind + ':')]
+        counts = [sum(1 for r in rows if r[1] == o) for o in OUTCOMES]
+        detections = [r[2] for r in rows if r[2] is not None]
+        lost = [r[4] for r in rows if r[4] is not None and r[1] != 'no effect']
+        print('%-14s %5d  %s  %s      %8.1f' % (kind, len(rows), '  '.join('%9d' % c for c in counts), describe(detections),
+                                                 statistics.mean(lost) if lost else 0.0))
+
+    print('\ncaught by:')
+    caught = {}
+    for row in results:
+        if row[3]:
+            caught[row[3]] = caught.get(row[3], 0) + 1
+    for name, count in sorted(caught.items(), key=lambda item: -item[1]):
+        print('  %-20s %d' % (name, count))
+    waiting = sum(1 for r in results if r[1] == 'operator')
+    print('\n%.0f%% of the faults needed the operator, %.0f%% ended in a printer timeout' %
+          (100.0 * waiting / len(results), 100.0 * sum(1 for r in results if r[1] == 'printer timeout') / len(results)))
+
+
+if __name__ == '__main__':
+    main()
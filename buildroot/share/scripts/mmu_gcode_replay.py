@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+
+""" Estimate the MMU time of a sliced multi-material print.
+
+  mmu_gcode_replay.py print.gcode [--sim program] [--cal NAME=VALUE ...] [--worst N] [--swaps]
+
+The tool changes of the G-code are turned into the commands Marlin sends to the
+MMU (T<n> then C0 for a new tool, U<n> for M702) and run through the firmware in
+the simulator (pio run -e sim), in one boot like the real print.
+
+Reports the total MMU time, the time per from -> to transition and the slowest
+swaps. With --cal, the print is also run with the default calibration and the
+difference is shown, i.e. what the tuning saves on this job.
+"""
+
+import argparse
+import collections
+import json
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+DEFAULT_SIM = os.path.join(ROOT, '.pio', 'build', 'sim', 'program')
+
+TOOL = re.compile(r'^T(\d+)\b')
+UNLOAD = re.compile(r'^M702\b')
+
+Swap = collections.namedtuple('Swap', 'line source target')
+
+
+def extract(path):
+    """ MMU commands of the G-code file, with the swap each T belongs to """
+    commands = []
+    swaps = []
+    current = None
+    with open(path, errors='replace') as f:
+        for number, line in enumerate(f, 1):
+            line = line.split(';', 1)[0].strip()
+            match = TOOL.match(line)
+            if match:
+                tool = int(match.group(1))
+                if tool > 4:
+                    print('line %d: T%d ignored, the MMU has 5 slots' % (number, tool), file=sys.stderr)
+                    continue
+                if tool == current:
+                    continue  # Marlin does not call the MMU for the active tool
+                swaps.append(Swap(number, current, tool))
+                commands += ['T%d' % tool, 'C0']
+                current = tool
+            elif UNLOAD.match(line) and current is not None:
+                commands.append('U%d' % current)
+                current = None
+    return commands, swaps
+
+
+def simulate(sim, commands, calibration):
+    args = [sim, '--json', '--limit', '1e9', '--script', '/dev/stdin']
+    for value in calibration:
+        args += ['--cal', value]
+    result = subprocess.run(args, input='\n'.join(commands) + '\n', stdout=subprocess.PIPE, universal_newlines=True)
+    report = json.loads(result.stdout)
+    if report['timed_out']:
+        sys.exit('simulation stopped: a command was not acknowledged (see mmu-sim --log)')
+    return report['commands'][3:]  # after the S1 / S2 / P0 handshake
+
+
+def swap_times(results, swaps):
+    """ T + C0 time of each swap """
+    times = []
+    for result in results:
+        if result['command'].startswith('T'):
+            times.append(result['seconds'])
+        elif result['command'] == 'C0' and times:
+            times[-1] += result['seconds']
+    return list(zip(swaps, times))
+
+
+def describe(slot):
+    return '-' if slot is None else str(slot)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('gcode')
+    parser.add_argument('--sim', default=DEFAULT_SIM, help='simulator program (default: %(default)s)')
+    parser.add_argument('--cal', action='append', default=[], metavar='NAME=VALUE', help='calibration to evaluate (see mmu-sim --cal)')
+    parser.add_argument('--worst', type=int, default=5, help='number of slowest swaps to list (default: %(default)s)')
+    parser.add_argument('--swaps', action='store_true', help='list every swap')
+    args = parser.parse_args()
+
+    if not os.path.exists(args.sim):
+        sys.exit('%s not found, build it with: pio run -e sim' % args.sim)
+    commands, swaps = extract(args.gcode)
+    if not swaps:
+        sys.exit('no tool change in %s' % args.gcode)
+
+    results = simulate(args.sim, commands, args.cal)
+    timed = swap_times(results, swaps)
+    total = sum(r['seconds'] for r in results)
+    unloads = sum(r['seconds'] for r in results if r['command'].startswith('U'))
+
+    print('%s: %d swaps, %d MMU commands' % (args.gcode, len(swaps), len(commands)))
+    print('total MMU time %.1f s (%.1f min), swaps %.1f s, final unload %.1f s' % (total, total / 60, total - unloads, unloads))
+
+    transitions = collections.defaultdict(list)
+    for swap, seconds in timed:
+        transitions[(swap.source, swap.target)].append(seconds)
+    print('\n%-8s %6s %9s %9s %9s' % ('from-to', 'count', 'mean s', 'max s', 'total s'))
+    for (source, target), values in sorted(transitions.items(), key=lambda item: -sum(item[1])):
+        print('%-8s %6d %9.2f %9.2f %9.1f' % ('%s-%s' % (describe(source), describe(target)), len(values),
+                                             sum(values) / len(values), max(values), sum(values)))
+
+    print('\nslowest swaps:')
+    for swap, seconds in sorted(timed, key=lambda item: -item[1])[:args.worst]:
+        print('  line %-8d %s -> %d  %.2f s' % (swap.line, describe(swap.source), swap.target, seconds))
+
+    if args.swaps:
+        print('\nall swaps:')
+        for swap, seconds in timed:
+            print('  line %-8d %s -> %d  %.2f s' % (swap.line, describe(swap.source), swap.target, seconds))
+
+    if args.cal:
+        reference = sum(r['seconds'] for r in simulate(args.sim, commands, []))
+        print('\nwith the default calibration: %.1f s, %s saves %.1f s (%.1f%%)' %
+              (reference, ' '.join(args.cal), reference - total, (reference - total) / reference * 100))
+
+
+if __name__ == '__main__':
+    main()
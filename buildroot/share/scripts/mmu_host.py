@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+
+""" Printer stand-in: plays the Marlin MMU2 client over a pty and times every command.
+
+  mmu_host.py [--commands "T1 C0 T2 C0 U2"] [--repeat N] [--program file] [--json file]
+  mmu_host.py --device /dev/ttyUSB0 [--baud 115200] ...
+
+Starts the firmware built for the host with the model on its pins (pio run -e
+native-model), with its Serial1 on a pty (MMU_SERIAL1). It can also talk to an
+MMU on a serial device instead (--device).
+
+Like Marlin: waits for "start", sends S1 (version), S2 (build) and P0 (FINDA),
+then each command when the previous one is acknowledged, with P0 polls in
+between (one every 300 ms while idle, --polls per gap). A command that gets no
+"ok" within Marlin's timeout (45 s, 3 s for P0) stops the run, the end of the
+firmware console is printed then.
+
+Every round trip (last byte written to "ok" received) is recorded: the table
+and a per command summary are printed, --json writes them all. The motion
+commands run in real time against the model, their times depend on the host;
+the simulator (pio run -e sim) times them on the modelled machine. What this
+measures is the protocol: line handling, dispatch and the ack path, e.g. with
+--no-newline the cost of the partial line timeout (SERIAL1_LINE_TIMEOUT).
+"""
+
+import argparse
+import json
+import os
+import select
+import signal
+import subprocess
+import sys
+import tempfile
+import termios
+import time
+import tty
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+DEFAULT_PROGRAM = os.path.join(ROOT, '.pio', 'build', 'native-model', 'program')
+
+# Marlin mmu2.cpp
+MMU_CMD_TIMEOUT = 45.0  # s
+MMU_P0_TIMEOUT = 3.0
+P0_INTERVAL = 0.3  # s between two polls while idle
+LOG_TAIL = 15  # console lines shown when a run stops
+
+BAUDS = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400, 57600: termios.B57600,
+         115200: termios.B115200, 230400: termios.B230400}
+
+
+class Link:
+    """ line oriented serial link with deadlines """
+
+    def __init__(self, fd, drain):
+        self.fd = fd
+        self.drain = drain  # a real UART: wait until the bytes are on the wire
+        self.buffer = b''
+
+    def write(self, text):
+        """ time the last byte left """
+        data = text.encode()
+        while data:
+            data = data[os.write(self.fd, data):]
+        if self.drain:
+            termios.tcdrain(self.fd)
+        return time.monotonic()
+
+    def readline(self, timeout):
+        """ (line, arrival time), (None, None) on timeout """
+        deadline = time.monotonic() + timeout
+        while b'\n' not in self.buffer:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                return None, None
+            try:
+                chunk = os.read(self.fd, 256)
+            except OSError:
+                return None, None  # the firmware went away
+            if not chunk:
+                return None, None
+            self.buffer += chunk
+        line, self.buffer = self.buffer.split(b'\n', 1)
+        return line.decode(errors='replace').strip(), time.monotonic()
+
+
+class Host:
+    def __init__(self, link, newline):
+        self.link = link
+        self.newline = newline
+        self.records = []
+        self.t0 = time.monotonic()
+
+    def command(self, text, timeout):
+        """ send one command, wait for its "ok"; False on timeout """
+        sent = self.link.write(text + ('\n' if self.newline else ''))
+        reply = ''
+        while True:
+            line, arrival = self.link.readline(timeout - (time.monotonic() - sent))
+            if line is None:
+                self.records.append({'command': text, 'sent_s': sent - self.t0, 'ok': False, 'reply': reply, 'rtt_ms': None})
+                return False
+            if line == 'start':
+                continue  # repeated during the firmware's startup window
+            if line.endswith('ok'):
+                reply += line[:-2]
+                self.records.append({'command': text, 'sent_s': sent - self.t0, 'ok': True, 'reply': reply,
+                                     'rtt_ms': (arrival - sent) * 1000})
+                return True
+            reply += line
+
+    def poll(self):
+        return self.command('P0', MMU_P0_TIMEOUT)
+
+
+def run(link, commands, polls, newline, start_timeout):
+    host = Host(link, newline)
+    while True:
+        line, arrival = link.readline(start_timeout - (time.monotonic() - host.t0))
+        if line is None:
+            sys.exit('no "start" from the MMU within %.0f s' % start_timeout)
+        if line == 'start':
+            break
+    host.start_s = arrival - host.t0
+    for text in ('S1', 'S2'):
+        if not host.command(text, MMU_CMD_TIMEOUT):
+            return host
+    if not host.poll():
+        return host
+    for text in commands:
+        if not host.command(text, MMU_P0_TIMEOUT if text.startswith('P') else MMU_CMD_TIMEOUT):
+            return host
+        for _ in range(polls):
+            time.sleep(P0_INTERVAL)
+            if not host.poll():
+                return host
+    return host
+
+
+def report(host, log_tail):
+    print('"start" after %.3f s' % host.start_s)
+    print('%-8s %10s %12s  %s' % ('command', 'sent s', 'round trip', 'reply'))
+    for r in host.records:
+        if r['command'] == 'P0' and r['ok'] and r is not host.records[-1]:
+            continue  # the summary has them
+        rtt = '%9.3f ms' % r['rtt_ms'] if r['ok'] else '   TIMEOUT'
+        print('%-8s %10.3f %12s  %s' % (r['command'], r['sent_s'], rtt, r['reply']))
+
+    kinds = {}
+    for r in host.records:
+        if r['ok']:
+            kinds.setdefault(r['command'][0], []).append(r['rtt_ms'])
+    print('\n%-4s %6s %10s %10s %10s %10s' % ('cmd', 'count', 'min ms', 'mean ms', 'p95 ms', 'max ms'))
+    for kind, values in sorted(kinds.items()):
+        values.sort()
+        p95 = values[min(len(values) - 1, int(round(0.95 * (len(values) - 1))))]
+        print('%-4s %6d %10.3f %10.3f %10.3f %10.3f' % (kind, len(values), values[0], sum(values) / len(values), p95, values[-1]))
+    failed = [r for r in host.records if not r['ok']]
+    if failed:
+        print('\n%s not acknowledged within Marlin\'s timeout, run stopped' % failed[0]['command'])
+        if log_tail:
+            print('last lines of the firmware console:')
+            sys.stdout.writelines(log_tail)
+
+
+def open_device(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[4] = attrs[5] = BAUDS[baud]
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--commands', default='T1 C0 T2 C0 U2', help='commands after the handshake (default: %(default)s)')
+    parser.add_argument('--repeat', type=int, default=1, help='run the command list this many times')
+    parser.add_argument('--polls', type=int, default=1, help='P0 polls between two commands (default: %(default)s)')
+    parser.add_argument('--no-newline', action='store_true', help='send the commands without the line feed')
+    parser.add_argument('--start-timeout', type=float, default=120, help='seconds to wait for "start" (default: %(default)s)')
+    parser.add_argument('--program', default=DEFAULT_PROGRAM, help='firmware host build (default: %(default)s)')
+    parser.add_argument('--log', help='firmware debug console output')
+    parser.add_argument('--device', help='talk to the MMU on this serial device instead')
+    parser.add_argument('--baud', type=int, default=115200, choices=sorted(BAUDS), help='with --device (default: %(default)s)')
+    parser.add_argument('--json', help='write every round trip to this file')
+    args = parser.parse_args()
+
+    commands = args.commands.replace(',', ' ').split() * args.repeat
+    firmware = None
+    workdir = None
+    if args.device:
+        fd = open_device(args.device, args.baud)
+    else:
+        if not os.path.exists(args.program):
+            sys.exit('%s not found, build it with: pio run -e native-model' % args.program)
+        fd, slave = os.openpty()
+        tty.setraw(slave)  # no echo before the firmware opens its end
+        workdir = tempfile.TemporaryDirectory()
+        env = dict(os.environ, MMU_SERIAL1=os.ttyname(slave), MMU_EEPROM=os.path.join(workdir.name, 'eeprom.bin'))
+        # kept when not asked for: a stopped run shows where the firmware was
+        log = open(args.log or os.path.join(workdir.name, 'console.log'), 'w')
+        # the console stays open (stdin), nothing is typed on it
+        firmware = subprocess.Popen([args.program], env=env, stdin=subprocess.PIPE, stdout=log)
+
+    log_tail = []
+    try:
+        host = run(Link(fd, bool(args.device)), commands, args.polls, not args.no_newline, args.start_timeout)
+    finally:
+        if firmware:
+            firmware.send_signal(signal.SIGTERM)
+            try:
+                firmware.wait(5)
+            except subprocess.TimeoutExpired:
+                firmware.kill()
+            log.close()
+            with open(log.name, errors='replace') as f:
+                log_tail = f.readlines()[-LOG_TAIL:]
+        if workdir:
+            workdir.cleanup()
+
+    report(host, log_tail)
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'start_s': host.start_s, 'records': host.records}, f, indent=1)
+    sys.exit(0 if all(r['ok'] for r in host.records) else 1)
+
+
+if __name__ == '__main__':
+    main()
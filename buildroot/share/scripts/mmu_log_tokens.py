@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+
+""" Token dictionary builder and decoder for the tokenized MMU log (LOG_TOKENIZED).
+
+  mmu_log_tokens.py dict <source dir> <dictionary.json>
+      scan the firmware sources for LOG_xxx("format", ...) calls and write the
+      token -> format string dictionary
+
+  mmu_log_tokens.py decode <dictionary.json> [capture file or serial device]
+      decode the frames sent on the debug serial port (stdin by default)
+
+See mmu2-diy/logtoken.h for the frame layout.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+FRAME_START = 0xFE
+
+LOG_CALL = re.compile(r'\bLOG_(?:ERROR|WARN|INFO|DEBUG)\s*\(\s*((?:"(?:[^"\\]|\\.)*"\s*|[A-Za-z_]\w*\s*)+)[,)]')
+STRING_DEFINE = re.compile(r'^\s*#\s*define\s+([A-Za-z_]\w*)\s+((?:"(?:[^"\\]|\\.)*"\s*)+)', re.M)
+STRING_LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+FORMAT_SPEC = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l)?([diuxXcs%])')
+
+ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '\\': '\\', '"': '"', "'": "'", '0': '\0'}
+
+
+def unescape(literal):
+    return re.sub(r'\\(.)', lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def fnv1a(text):
+    value = 2166136261
+    for byte in text.encode('latin-1'):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def read_sources(src_dir):
+    for name in sorted(os.listdir(src_dir)):
+        if os.path.splitext(name)[1] in ('.h', '.cpp', '.ino'):
+            with open(os.path.join(src_dir, name), encoding='latin-1') as f:
+                yield name, f.read()
+
+
+def build_dictionary(src_dir):
+    sources = list(read_sources(src_dir))
+    defines = {}
+    for _, text in sources:
+        for name, literals in STRING_DEFINE.findall(text):
+            defines[name] = ''.join(unescape(s) for s in STRING_LITERAL.findall(literals))
+
+    tokens = {}
+    for name, text in sources:
+        for match in LOG_CALL.finditer(text):
+            line = text[text.rfind('\n', 0, match.start()) + 1:match.start()]
+            if line.lstrip().startswith('#'):
+                continue  # the macro definitions themselves
+            fmt = ''
+            for part in re.findall(r'"(?:[^"\\]|\\.)*"|[A-Za-z_]\w*', match.group(1)):
+                if part.startswith('"'):
+                    fmt += unescape(part[1:-1])
+                elif part in defines:
+                    fmt += defines[part]
+                else:
+                    sys.exit('%s: cannot resolve log format macro %s' % (name, part))
+            token = '%08x' % fnv1a(fmt)
+            if tokens.get(token, fmt) != fmt:
+                sys.exit('token collision between "%s" and "%s"' % (tokens[token], fmt))
+            tokens[token] = fmt
+    return tokens
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def render(fmt, payload):
+    pos = 0
+
+    def convert(match):
+        nonlocal pos
+        flags, _, conv = match.groups()
+        if conv == '%':
+            return '%'
+        if conv == 'c':
+            value = chr(payload[pos])
+            pos += 1
+        elif conv == 's':
+            length = payload[pos]
+            value = payload[pos + 1:pos + 1 + length].decode('latin-1')
+            pos += 1 + length
+        else:
+            value, pos = read_varint(payload, pos)
+            if conv in 'di':
+                value = (value >> 1) ^ -(value & 1)
+        return ('%' + flags + conv) % value
+
+    return FORMAT_SPEC.sub(convert, fmt)
+
+
+def decode(tokens, stream, out):
+    data = bytearray()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        data += chunk
+        while True:
+            start = data.find(FRAME_START)
+            if start < 0:
+                data.clear()
+                break
+            if len(data) < start + 2 or len(data) < start + 2 + data[start + 1]:
+                del data[:start]
+                break
+            length = data[start + 1]
+            frame = bytes(data[start + 2:start + 2 + length])
+            token = '%08x' % int.from_bytes(frame[:4], 'little')
+            if length < 4 or token not in tokens:
+                del data[:start + 1]  # not a frame, resync on the next start byte
+                continue
+            del data[:start + 2 + length]
+            try:
+                out.write(render(tokens[token], frame[4:]) + '\n')
+            except IndexError:
+                out.write('<truncated frame %s: %s>\n' % (token, tokens[token]))
+            out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='command')
+    p = sub.add_parser('dict', help='build the token dictionary')
+    p.add_argument('src_dir')
+    p.add_argument('output')
+    p = sub.add_parser('decode', help='decode a capture')
+    p.add_argument('dictionary')
+    p.add_argument('input', nargs='?')
+    args = parser.parse_args()
+
+    if args.command == 'dict':
+        tokens = build_dictionary(args.src_dir)
+        with open(args.output, 'w') as f:
+            json.dump(tokens, f, indent=1, sort_keys=True)
+        print('%d log tokens written to %s' % (len(tokens), args.output))
+    elif args.command == 'decode':
+        with open(args.dictionary) as f:
+            tokens = json.load(f)
+        stream = open(args.input, 'rb', buffering=0) if args.input else sys.stdin.buffer
+        decode(tokens, stream, sys.stdout)
+    else:
+        parser.print_help()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+
+""" Convert an MMU event trace dump into a Chrome / Perfetto trace.
+
+  mmu_trace.py capture [-o trace.json] [--gap MS] [--dump N]
+
+capture is the debug console output of the 'E' command (firmware built with
+EVENT_TRACE, see mmu2-diy/trace.h), with any other log lines around it. Decode
+a tokenized log with mmu_log_tokens.py first. The simulator writes one with:
+
+  .pio/build/sim/program --commands "T1 C0 T2 C0" --log capture.txt --console E
+
+The JSON file opens in chrome://tracing or ui.perfetto.dev: one track for the
+printer commands (receive to ack), one for the tool change phases, one per motor
+driver (enabled), the FINDA and filament switch levels, and fixTheProblem().
+
+The summary printed splits each command into the time spent in its phases and
+the dead time around and between them, and lists the gaps longer than --gap.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+TRACE_COMMAND, TRACE_ACK, TRACE_PHASE_BEGIN, TRACE_PHASE_END, TRACE_PROBLEM, TRACE_PROBLEM_END, \
+    TRACE_FINDA, TRACE_SWITCH, TRACE_MOTOR_IDLER, TRACE_MOTOR_SELECTOR, TRACE_MOTOR_EXTRUDER = range(11)
+
+# stats.h
+PHASES = ['unload', 'select', 'feed', 'C']
+FAILURES = ['selector blocked', 'load: FINDA', 'unload: extruder', 'unload: bowden', 'feed: FINDA',
+            'switch stuck', 'feed: extruder', 'C: extruder']
+
+MOTORS = {TRACE_MOTOR_IDLER: 'idler', TRACE_MOTOR_SELECTOR: 'selector', TRACE_MOTOR_EXTRUDER: 'extruder'}
+SENSORS = {TRACE_FINDA: 'FINDA', TRACE_SWITCH: 'filament switch'}
+
+TID_COMMANDS, TID_PHASES, TID_PROBLEMS = 1, 2, 3
+TID_MOTOR = {TRACE_MOTOR_IDLER: 4, TRACE_MOTOR_SELECTOR: 5, TRACE_MOTOR_EXTRUDER: 6}
+THREADS = {TID_COMMANDS: 'printer commands', TID_PHASES: 'tool change phases', TID_PROBLEMS: 'fixTheProblem',
+           4: 'idler driver', 5: 'selector driver', 6: 'extruder driver'}
+
+BEGIN = re.compile(r'^E BEGIN (\d+) (\d+)\s*$')
+EVENT = re.compile(r'^E (\d+) (\d+) (\d+)\s*$')
+END = re.compile(r'^E END (\d+)\s*$')
+
+
+def read_dumps(path):
+    """ list of dumps, each a list of (us, event, arg) """
+    dumps = []
+    current = None
+    with open(path, errors='replace') as f:
+        for line in f:
+            line = line.strip()
+            if BEGIN.match(line):
+                current = []
+                older = int(BEGIN.match(line).group(2))
+                if older:
+                    print('%d older events were overwritten, the trace starts later' % older, file=sys.stderr)
+            elif END.match(line) and current is not None:
+                if int(END.match(line).group(1)):
+                    print('%s events were overwritten during the dump' % END.match(line).group(1), file=sys.stderr)
+                dumps.append(current)
+                current = None
+            elif EVENT.match(line) and current is not None:
+                current.append(tuple(int(x) for x in EVENT.match(line).groups()))
+    return dumps
+
+
+def unwrap(events):
+    """ micros() wraps after 2^32 us, the events are in order """
+    offset = 0
+    last = None
+    result = []
+    for us, event, arg in events:
+        if last is not None and us < last:
+            offset += 1 << 32
+        last = us
+        result.append((us + offset, event, arg))
+    return result
+
+
+def command_name(arg):
+    return chr(arg) if 32 < arg < 127 else '?'
+
+
+def convert(events):
+    trace = []
+    start = events[0][0] if events else 0
+    open_commands = []
+    open_problems = {}
+    motor_on = {}
+
+    for tid, name in THREADS.items():
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': tid, 'args': {'name': name}})
+        trace.append({'ph': 'M', 'name': 'thread_sort_index', 'pid': 1, 'tid': tid, 'args': {'sort_index': tid}})
+    trace.append({'ph': 'M', 'name': 'process_name', 'pid': 1, 'args': {'name': 'MMU'}})
+
+    for us, event, arg in events:
+        ts = us - start
+        if event == TRACE_COMMAND:
+            open_commands.append((command_name(arg), ts))
+        elif event == TRACE_ACK:
+            name = command_name(arg)
+            match = [c for c in open_commands if c[0] == name]
+            if match:
+                open_commands.remove(match[0])
+                trace.append({'ph': 'X', 'name': name, 'pid': 1, 'tid': TID_COMMANDS, 'ts': match[0][1],
+                              'dur': ts - match[0][1]})
+        elif event in (TRACE_PHASE_BEGIN, TRACE_PHASE_END):
+            name = PHASES[arg] if arg < len(PHASES) else 'phase %d' % arg
+            trace.append({'ph': 'B' if event == TRACE_PHASE_BEGIN else 'E', 'name': name, 'pid': 1,
+                          'tid': TID_PHASES, 'ts': ts})
+        elif event == TRACE_PROBLEM:
+            open_problems[arg] = ts
+        elif event == TRACE_PROBLEM_END and arg in open_problems:
+            began = open_problems.pop(arg)
+            name = FAILURES[arg] if arg < len(FAILURES) else 'failure %d' % arg
+            trace.append({'ph': 'X', 'name': name, 'pid': 1, 'tid': TID_PROBLEMS, 'ts': began, 'dur': ts - began})
+        elif event in SENSORS:
+            trace.append({'ph': 'C', 'name': SENSORS[event], 'pid': 1, 'ts': ts, 'args': {'level': arg}})
+        elif event in MOTORS:
+            if arg and event not in motor_on:
+                motor_on[event] = ts
+            elif not arg and event in motor_on:
+                began = motor_on.pop(event)
+                trace.append({'ph': 'X', 'name': MOTORS[event] + ' enabled', 'pid': 1, 'tid': TID_MOTOR[event],
+                              'ts': began, 'dur': ts - began})
+
+    # still running at the time of the dump
+    end = events[-1][0] - start if events else 0
+    for name, began in open_commands:
+        trace.append({'ph': 'X', 'name': name + ' (no ack)', 'pid': 1, 'tid': TID_COMMANDS, 'ts': began, 'dur': end - began})
+    for arg, began in open_problems.items():
+        trace.append({'ph': 'X', 'name': 'problem %d (pending)' % arg, 'pid': 1, 'tid': TID_PROBLEMS, 'ts': began,
+                      'dur': end - began})
+    for event, began in motor_on.items():
+        trace.append({'ph': 'X', 'name': MOTORS[event] + ' enabled', 'pid': 1, 'tid': TID_MOTOR[event], 'ts': began,
+                      'dur': end - began})
+    return trace
+
+
+def dead_time(events, gap_ms):
+    """ per command: phase time, dead time and the long gaps outside the phases """
+    start = events[0][0] if events else 0
+    command = None
+    print('%-4s %10s %10s %10s %10s' % ('cmd', 'start s', 'total ms', 'phases ms', 'dead ms'))
+    for us, event, arg in events:
+        if event == TRACE_COMMAND:
+            command = {'name': command_name(arg), 'start': us, 'phase': None, 'busy': 0, 'idle_from': us, 'gaps': []}
+        elif command is None:
+            continue
+        elif event == TRACE_PHASE_BEGIN and command['phase'] is None:
+            command['phase'] = us
+            if us - command['idle_from'] >= gap_ms * 1000:
+                command['gaps'].append((command['idle_from'], us, 'before %s' % PHASES[arg]))
+        elif event == TRACE_PHASE_END and command['phase'] is not None:
+            command['busy'] += us - command['phase']
+            command['phase'] = None
+            command['idle_from'] = us
+            command['after'] = PHASES[arg]
+        elif event == TRACE_ACK and command_name(arg) == command['name']:
+            total = us - command['start']
+            if command['phase'] is None and us - command['idle_from'] >= gap_ms * 1000 and command['busy']:
+                command['gaps'].append((command['idle_from'], us, 'after %s, before the ack' % command['after']))
+            print('%-4s %10.3f %10.1f %10.1f %10.1f' % (command['name'], (command['start'] - start) / 1e6, total / 1e3,
+                                                       command['busy'] / 1e3, (total - command['busy']) / 1e3))
+            for begin, end, where in command['gaps']:
+                print('       gap %8.1f ms at %.3f s, %s' % ((end - begin) / 1e3, (begin - start) / 1e6, where))
+            command = None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('capture')
+    parser.add_argument('-o', '--output', help='trace file (default: capture name with .json)')
+    parser.add_argument('--gap', type=float, default=50, help='list the dead gaps longer than this, ms (default: %(default)s)')
+    parser.add_argument('--dump', type=int, default=-1, help='which dump of the capture, 0 is the first (default: the last)')
+    args = parser.parse_args()
+
+    dumps = read_dumps(args.capture)
+    if not dumps:
+        sys.exit('no event trace dump (E BEGIN ... E END) in %s' % args.capture)
+    events = unwrap(dumps[args.dump])
+
+    output = args.output or os.path.splitext(args.capture)[0] + '.json'
+    with open(output, 'w') as f:
+        json.dump({'traceEvents': convert(events), 'displayTimeUnit': 'ms'}, f)
+    print('%d events, %.3f s, written to %s\n' % (len(events), (events[-1][0] - events[0][0]) / 1e6 if events else 0, output))
+    dead_time(events, args.gap)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+
+""" Motion settings sweep: swap time against the margin to stall and jam.
+
+  mmu_tune.py [--samples N] [--jobs N] [--seed N] [--csv file] [--sim program]
+              [--range NAME=LOW:HIGH ...] [--fix NAME=VALUE ...]
+
+Each candidate is a set of calibration values (the K console command names, see
+calibration.h) drawn at random within the safe ranges below. It is run in the
+simulator (pio run -e sim) on a fixed workload that visits every slot. The
+candidates run in parallel, one simulator process per core.
+
+A candidate scores two numbers:
+  time     virtual seconds for the whole workload
+  margin   stall margin, the smallest of shortest step interval / stall interval - 1
+           over the three motors: 0 means a motor is at its limit
+The jam margin (alignment tolerance left at the selector entry and at the idler
+grip, relative to cstol / idlertol) does not depend on speeds, it is shown as a
+check. A candidate that jams, slips, has no margin left, needs the operator or
+leaves a command unacknowledged is rejected. The Pareto front (no other
+candidate both faster and with more stall margin) is printed, the default
+calibration is always candidate 0.
+"""
+
+import argparse
+import csv
+import json
+import multiprocessing
+import os
+import random
+import subprocess
+import sys
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..', '..'))
+DEFAULT_SIM = os.path.join(ROOT, '.pio', 'build', 'sim', 'program')
+
+WORKLOAD = 'T0 C0 T1 C0 T2 C0 T3 C0 T4 C0 T1 C0 T3 C0 T0 C0 U0'
+
+# default (config.h) and physically safe range of each swept value
+PARAMETERS = {
+    'idlerdelay': (540, 200, 1000),  # IDLERMOTORDELAY us
+    'extdelay': (60, 20, 300),       # EXTRUDERMOTORDELAY us
+    'csdelay': (60, 20, 300),        # COLORSELECTORMOTORDELAY us
+    'loadspeed': (30, 10, 60),       # LOAD_SPEED mm/s
+    'loadms': (1000, 400, 2000),     # LOAD_DURATION ms
+    'dist': (690, 640, 720),         # DIST_MMU_EXTRUDER mm
+    'back': (30, 20, 40),            # UNLOAD_LENGTH_BACK_COLORSELECTOR mm
+}
+
+AXES = ('idler', 'selector', 'extruder')
+
+
+def evaluate(job):
+    sim, values, timeout, tolerances = job
+    args = [sim, '--json', '--commands', WORKLOAD, '--timeout', str(timeout), '--operator', '1']
+    for name, value in sorted(values.items()):
+        args += ['--cal', '%s=%d' % (name, value)]
+    result = subprocess.run(args, stdout=subprocess.PIPE, universal_newlines=True)
+    try:
+        report = json.loads(result.stdout)
+    except ValueError:
+        return values, None, 'simulator error'
+
+    model = report['model']
+    if report['timed_out']:
+        return values, None, 'command not acknowledged'
+    if report['operator_calls']:
+        return values, None, 'operator needed'
+    if model['jams'] or model['slips']:
+        return values, None, 'jam' if model['jams'] else 'slip'
+
+    margins = []
+    for axis in AXES:
+        interval = model[axis]['min_interval_us']
+        if interval >= 0:
+            margins.append(interval / model[axis]['stall_us'] - 1)
+    margin = min(margins)
+    jam = min(model['selector_margin'] / tolerances['cstol'], model['idler_margin'] / tolerances['idlertol'])
+    if margin <= 0:
+        return values, None, 'stall'
+    if jam <= 0:
+        return values, None, 'no alignment margin'
+    return values, (report['total_s'], margin, jam), None
+
+
+def pareto(points):
+    front = []
+    for values, score in points:
+        time, margin = score[:2]
+        dominated = any((t <= time and m >= margin) and (t < time or m > margin) for _, (t, m, _) in points)
+        if not dominated:
+            front.append((values, score))
+    return sorted(front, key=lambda point: point[1][0])
+
+
+def parse_pairs(items, split):
+    pairs = {}
+    for item in items:
+        name, _, value = item.partition('=')
+        if name not in PARAMETERS or not value:
+            sys.exit('unknown parameter %s, one of: %s' % (item, ', '.join(sorted(PARAMETERS))))
+        pairs[name] = split(value)
+    return pairs
+
+
+def model_tolerances(sim):
+    """ the model tolerances the margins are relative to """
+    tolerances = {}
+    params = subprocess.run([sim, '--params'], stdout=subprocess.PIPE, universal_newlines=True).stdout
+    for line in params.split('\n'):
+        fields = line.split()
+        if fields and fields[0] in ('cstol', 'idlertol'):
+            tolerances[fields[0]] = float(fields[1])
+    return tolerances
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--sim', default=DEFAULT_SIM, help='simulator program (default: %(default)s)')
+    parser.add_argument('--samples', type=int, default=200, help='number of candidates (default: %(default)s)')
+    parser.add_argument('--jobs', type=int, default=multiprocessing.cpu_count(), help='parallel simulations (default: all cores)')
+    parser.add_argument('--seed', type=int, default=1, help='random seed (default: %(default)s)')
+    parser.add_argument('--timeout', type=float, default=120, help='virtual seconds before a command counts as failed')
+    parser.add_argument('--range', action='append', default=[], metavar='NAME=LOW:HIGH', help='change a sweep range')
+    parser.add_argument('--fix', action='append', default=[], metavar='NAME=VALUE', help='keep a value constant')
+    parser.add_argument('--csv', help='write every candidate to this file')
+    args = parser.parse_args()
+
+    if not os.path.exists(args.sim):
+        sys.exit('%s not found, build it with: pio run -e sim' % args.sim)
+    ranges = {name: (low, high) for name, (_, low, high) in PARAMETERS.items()}
+    ranges.update(parse_pairs(args.range, lambda v: tuple(int(x) for x in v.split(':'))))
+    fixed = parse_pairs(args.fix, int)
+
+    rng = random.Random(args.seed)
+    candidates = [{name: default for name, (default, _, _) in PARAMETERS.items()}]
+    for _ in range(args.samples - 1):
+        values = {name: rng.randint(low, high) for name, (low, high) in ranges.items()}
+        values.update(fixed)
+        candidates.append(values)
+
+    with multiprocessing.Pool(args.jobs) as pool:
+        tolerances = model_tolerances(args.sim)
+        results = pool.map(evaluate, [(args.sim, values, args.timeout, tolerances) for values in candidates], chunksize=1)
+
+    accepted = [(values, score) for values, score, _ in results if score]
+    rejected = [(values, reason) for values, score, reason in results if not score]
+    default = results[0]
+
+    names = sorted(PARAMETERS)
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(names + ['time_s', 'margin', 'jam_margin', 'rejected'])
+            for values, score, reason in results:
+                writer.writerow([values[n] for n in names] + (list(score) if score else ['', '', '']) + [reason or ''])
+
+    print('%d candidates on %d cores: %d accepted, %d rejected' % (len(results), args.jobs, len(accepted), len(rejected)))
+    reasons = {}
+    for _, reason in rejected:
+        reasons[reason] = reasons.get(reason, 0) + 1
+    for reason, count in sorted(reasons.items()):
+        print('  %-26s %d' % (reason, count))
+    if default[1]:
+        print('default calibration: %.2f s, margin %.2f, jam margin %.2f' % default[1])
+    else:
+        print('default calibration rejected: %s' % default[2])
+
+    print('\nPareto front (fastest first):')
+    print('%9s %7s %7s  %s' % ('time s', 'margin', 'jam', '  '.join('%10s' % n for n in names)))
+    for values, (time, margin, jam) in pareto(accepted):
+        print('%9.2f %7.2f %7.2f  %s' % (time, margin, jam, '  '.join('%10d' % values[n] for n in names)))
+
+
+if __name__ == '__main__':
+    main()
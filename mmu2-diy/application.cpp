@@ -14,6 +14,18 @@
 #include "application.h"
 
 #include "config.h"
+#include "latency.h"
+#include "status.h"
+#include "raminfo.h"
+#include "calibration.h"
+#include "storage.h"
+#include "mechstate.h"
+#include "stats.h"
+#include "journal.h"
+#include "trace.h"
+#include "recorder.h"
+#include "scheduler.h"
+#include "pt.h"
 
 /*************** */
 char cstr[16];
@@ -23,10 +35,10 @@ IOPrint ioprint;
 
 int command = 0;
 
-// absolute position of bearing stepper motor
-int bearingAbsPos[5] = {0 + IDLEROFFSET[0], IDLERSTEPSIZE + IDLEROFFSET[1], IDLERSTEPSIZE * 2 + IDLEROFFSET[2], IDLERSTEPSIZE * 3 + IDLEROFFSET[3], IDLERSTEPSIZE * 4 + IDLEROFFSET[4]};
-// absolute position of selector stepper motor
-int selectorAbsPos[5] = {0 + CSOFFSET[0], CSSTEPS * 1 + CSOFFSET[1], CSSTEPS * 2 + CSOFFSET[2], CSSTEPS * 3 + CSOFFSET[3], CSSTEPS * 4 + CSOFFSET[4]};
+// absolute position of bearing stepper motor (see applyCalibration())
+int bearingAbsPos[5];
+// absolute position of selector stepper motor (see applyCalibration())
+int selectorAbsPos[5];
 
 //stepper direction
 #define CW 0
@@ -50,9 +62,11 @@ int repeatTCmdFlag = INACTIVE; // used by the 'C' command processor to avoid pro
 
 int oldBearingPosition = 0; // this tracks the roller bearing position (top motor on the MMU)
 int filamentSelection = 0;  // keep track of filament selection (0,1,2,3,4))
-int dummy[100];
 char currentExtruder = '0';
 
+char motionCommand = 0;		 // T, C, U or L run by motionThread(), 0: none
+bool problemPending = false; // fixTheProblemThread() waits for the operator's key
+
 int firstTimeFlag = 0;
 int earlyCommands = 0; // forcing communications with the mk3 at startup
 
@@ -63,6 +77,27 @@ boolean newData = false;
 int idlerStatus = INACTIVE;
 int colorSelectorStatus = INACTIVE;
 
+/*****************************************************
+ *
+ * Tasks, most urgent first (see scheduler.h)
+ *
+ *****************************************************/
+static Task tasks[] = {
+	{serial1Receive, serial1Ready, 0, 0},		// serial RX
+	{dispatchCommand, dispatchReady, 0, 0},		// command dispatch, a complete line and no motion running
+#ifdef SERIAL_DEBUG
+	{consoleReceive, consoleReady, 0, 0},		// debug console
+#endif
+	{monitorSensors, NULL, SENSOR_PERIOD, 0},	// sensors
+	{log_drain, log_pending, 0, 0},				// log
+#ifdef FIELD_RECORDER
+	{recorder_drain, recorder_pending, 0, 0},	// field recorder
+#endif
+	{displayRefresh, NULL, DISPLAY_PERIOD, 0},	// display
+	{maintenance, NULL, MAINTENANCE_PERIOD, 0},	// maintenance
+	{motionStep, motionReady, 0, 0},			// motion, last: it is due as long as it runs
+};
+
 /*****************************************************
  *
  * Init the MMU, pin, Serial, ...
@@ -70,42 +105,38 @@ int colorSelectorStatus = INACTIVE;
  *****************************************************/
 void Application::setup()
 {
-	int waitCount;
+	unsigned long bootStart, lastStart;
 	/************/
+	ram_paint_stack();
 	ioprint.setup();
+#ifdef FIELD_RECORDER
+	recorder_begin(); // before the first record is loaded
+#endif
+	status_setup();
+
+	calibration_load();
+	applyCalibration();
+	stats_load();
 	/************/
 
-	println_log(MMU2_VERSION);
-	delay(200);
+	LOG_INFO(MMU2_VERSION);
 
 	Serial1.begin(115200); // Hardware serial interface (mmu<->printer board)
-	delay(100);
+	while (!Serial1)
+	{
+		// wait for the UART to be ready (returns at once on the hardware serial ports)
+	}
 
-	println_log(F("Sending START command to mk3 controller board"));
+	LOG_INFO("Sending START command to mk3 controller board");
 	// ***************************************
 	// THIS NEXT COMMAND IS CRITICAL ... IT TELLS THE MK3 controller that an MMU is present
 	// ***************************************
-	Serial1.print(F("start\n")); // attempt to tell the mk3 that the mmu is present
-
-	//***************************
-	//  check the serial interface to see if it is active
-	//***************************
-	waitCount = 0;
-	while (!Serial1.available())
-	{
-
-		println_log(F("Waiting for message from mk3"));
-		delay(1000);
-		++waitCount;
-		if (waitCount >= S1_WAIT_TIME)
-		{
-			println_log(F("X seconds have passed, aborting wait for printer board (Marlin) to respond"));
-			goto continue_processing;
-		}
-	}
-	println_log(F("inbound message from Marlin"));
+	PRINTER_SERIAL.print(F("start\n")); // attempt to tell the mk3 that the mmu is present
+	bootStart = lastStart = millis();
 
-continue_processing:
+	// the answer of the printer is queued by the serial receive interrupt, so the axes
+	// are set up and homed while the handshake is pending: boot time is the longer of
+	// the two instead of their sum
 
 	pinMode(idlerDirPin, OUTPUT);
 	pinMode(idlerStepPin, OUTPUT);
@@ -125,28 +156,75 @@ continue_processing:
 
 	pinMode(greenLED, OUTPUT); // green LED used for debug purposes
 
-	println_log(F("finished setting up input and output pins"));
+	LOG_INFO("finished setting up input and output pins");
 
 	// Turn OFF all three stepper motors (heat protection)
-	digitalWrite(idlerEnablePin, DISABLE);		   // DISABLE the roller bearing motor (motor #1)
-	digitalWrite(extruderEnablePin, DISABLE);	  //  DISABLE the extruder motor  (motor #2)
-	digitalWrite(colorSelectorEnablePin, DISABLE); // DISABLE the color selector motor  (motor #3)
+	motorEnable(idlerEnablePin, DISABLE);		   // DISABLE the roller bearing motor (motor #1)
+	motorEnable(extruderEnablePin, DISABLE);	  //  DISABLE the extruder motor  (motor #2)
+	motorEnable(colorSelectorEnablePin, DISABLE); // DISABLE the color selector motor  (motor #3)
 
-	// Initialize stepper
-	println_log(F("Syncing the Idler Selector Assembly")); // do this before moving the selector motor
-	initIdlerPosition();								   // reset the roller bearing position
-
-	println_log(F("Syncing the Filament Selector Assembly"));
-	if (!isFilamentLoadedPinda())
+	if (recoverToolChange())
 	{
-		initColorSelector(); // reset the color selector if there is NO filament present
+		LOG_INFO("Interrupted tool change recovered (slot %d)", filamentSelection);
+	}
+	else if (warmBoot())
+	{
+		LOG_INFO("Warm boot: positions restored, homing skipped (slot %d)", filamentSelection);
 	}
 	else
 	{
-		println_log(F("Unable to clear the Color Selector, please remove filament"));
+		mechstate_motion_begin();
+
+		// Initialize stepper
+		LOG_INFO("Syncing the Idler Selector Assembly"); // do this before moving the selector motor
+		initIdlerPosition();							 // reset the roller bearing position
+
+		LOG_INFO("Syncing the Filament Selector Assembly");
+		if (!isFilamentLoadedPinda())
+		{
+			initColorSelector(); // reset the color selector if there is NO filament present
+			currentPosition = 0;
+			recordMechanicalState();
+		}
+		else
+		{
+			// the selector position stays unknown: no clean record, the next boot homes again
+			LOG_WARN("Unable to clear the Color Selector, please remove filament");
+		}
 	}
 
-	println_log(F("Inialialization Complete, let's multicolor print ...."));
+	//***************************
+	//  check the serial interface to see if it is active
+	//***************************
+	// whatever is left of the S1_WAIT_TIME window, "start" is repeated in case the printer was not listening yet
+	while (!printerAvailable())
+	{
+		log_drain();
+#ifdef FIELD_RECORDER
+		recorder_drain();
+#endif
+		status_refresh();
+		if ((millis() - bootStart) >= (unsigned long)S1_WAIT_TIME * 1000)
+		{
+			LOG_WARN("X seconds have passed, aborting wait for printer board (Marlin) to respond");
+			break;
+		}
+		if ((millis() - lastStart) >= START_RESEND_INTERVAL)
+		{
+			LOG_INFO("Waiting for message from mk3, sending START again");
+			PRINTER_SERIAL.print(F("start\n"));
+			lastStart = millis();
+		}
+	}
+	if (printerAvailable())
+	{
+		LOG_INFO("inbound message from Marlin");
+	}
+	LOG_INFO("Boot time: %lu ms", millis() - bootStart);
+
+	LOG_INFO("Inialialization Complete, let's multicolor print ....");
+
+	scheduler_setup(tasks, sizeof(tasks) / sizeof(tasks[0]));
 
 } // end of init() routine
 
@@ -157,140 +235,354 @@ continue_processing:
  *****************************************************/
 void Application::loop()
 {
-	String kbString;
-
-	// wait for 100 milliseconds
-	delay(100);
-	// check the serial interface for input commands from the mk3
-	checkSerialInterface();
+	// one task per pass: the most urgent due task of the table above
+	scheduler_run();
+} // end of infinite loop
 
 #ifdef SERIAL_DEBUG
-	// check for keyboard input
+/*****************************************************
+ *
+ * Handle a command from the debug console
+ *
+ *****************************************************/
+void processConsoleCommand(const CommandLine &kbString)
+{
+	LOG_INFO("Key was hit ");
 
-	if (Serial.available())
+	bool motion = (strchr("CTUDA", kbString[0]) != NULL) && (kbString[0] != 0);
+	if (motion)
 	{
-		println_log(F("Key was hit "));
-
-		kbString = ReadSerialStrUntilNewLine();
+		mechstate_motion_begin();
+	}
 
-		if (kbString[0] == 'C')
+	if (kbString[0] == 'C')
+	{
+		LOG_INFO("Processing 'C' Command");
+		filamentLoadWithBondTechGear();
+	}
+	if (kbString[0] == 'T')
+	{
+		LOG_INFO("Processing 'T' Command");
+		if ((kbString[1] >= '0') && (kbString[1] <= '4'))
 		{
-			println_log(F("Processing 'C' Command"));
-			filamentLoadWithBondTechGear();
+			toolChange(kbString[1]);
 		}
-		if (kbString[0] == 'T')
+		else
 		{
-			println_log(F("Processing 'T' Command"));
-			if ((kbString[1] >= '0') && (kbString[1] <= '4'))
-			{
-				toolChange(kbString[1]);
-			}
-			else
-			{
-				println_log(F("T: Invalid filament Selection"));
-			}
+			LOG_WARN("T: Invalid filament Selection");
 		}
-		if (kbString[0] == 'U')
+	}
+	if (kbString[0] == 'U')
+	{
+		LOG_INFO("Processing 'U' Command");
+		if (idlerStatus == QUICKPARKED)
 		{
-			println_log(F("Processing 'U' Command"));
-			if (idlerStatus == QUICKPARKED)
-			{
-				quickUnParkIdler(); // un-park the idler from a quick park
-			}
-			if (idlerStatus == INACTIVE)
-			{
-				unParkIdler(); // turn on the idler motor
-			}
-			unloadFilamentToFinda(); //unload the filament
-			parkIdler();			 // park the idler motor and turn it off
+			quickUnParkIdler(); // un-park the idler from a quick park
+		}
+		if (idlerStatus == INACTIVE)
+		{
+			unParkIdler(); // turn on the idler motor
 		}
+		unloadFilamentToFinda(); //unload the filament
+		parkIdler();			 // park the idler motor and turn it off
+	}
 #ifdef DEBUGMODE
-		if (kbString[0] == 'D')
+	if (kbString[0] == 'D')
+	{
+		LOG_INFO("Processing 'D' Command");
+		LOG_INFO("initColorSelector");
+		initColorSelector();
+		LOG_INFO("initIdlerPosition");
+		initIdlerPosition();
+		char colors[5] = {'0', '1', '2', '3', '4'};
+		for (int i = 0; i < 5; i++)
 		{
-			println_log(F("Processing 'D' Command"));
-			println_log(F("initColorSelector"));
-			initColorSelector();
-			println_log(F("initIdlerPosition"));
-			initIdlerPosition();
-			char colors[5] = {'0', '1', '2', '3', '4'};
-			for (int i = 0; i < 5; i++)
-			{
-				char c = colors[i];
-				print_log(F("Color "));
-				println_log(c);
-				idlerSelector(c);
-				colorSelector(c);
-				filamentLoadToMK3();
-				unloadFilamentToFinda();
-				delay(5000);
-			}
+			char c = colors[i];
+			LOG_INFO("Color %c", c);
+			idlerSelector(c);
+			colorSelector(c);
+			filamentLoadToMK3();
+			unloadFilamentToFinda();
+			delay(5000);
 		}
-		else if (kbString[0] == 'Z')
+	}
+	else if (kbString[0] == 'Z')
+	{
+		LOG_INFO("FINDA status: %d", sensorRead(findaPin));
+		LOG_INFO("colorSelectorEnstop status: %d", sensorRead(colorSelectorEnstop));
+		LOG_INFO("Extruder endstop status: %d", sensorRead(filamentSwitch));
+		LOG_INFO("PINDA | EXTRUDER");
+		while (true)
 		{
-			print_log(F("FINDA status: "));
-			int fstatus = digitalRead(findaPin);
-			println_log(fstatus);
-			print_log(F("colorSelectorEnstop status: "));
-			int cdenstatus = digitalRead(colorSelectorEnstop);
-			println_log(cdenstatus);
-			print_log(F("Extruder endstop status: "));
-			fstatus = digitalRead(filamentSwitch);
-			Serial.println(fstatus);
-			println_log(F("PINDA | EXTRUDER"));
-			while (true)
+			LOG_INFO("%-5s | %s", isFilamentLoadedPinda() ? "ON" : "OFF", isFilamentLoadedtoExtruder() ? "ON" : "OFF");
+			log_flush();
+			status_refresh();
+			delay(200);
+			if (consoleAvailable())
 			{
-				isFilamentLoadedPinda() ? print_log(F("ON    | ")) : print_log(F("OFF   | "));
-				isFilamentLoadedtoExtruder() ? println_log(F("ON")) : println_log(F("OFF"));
-				delay(200);
-				if (Serial.available())
-				{
-					ReadSerialStrUntilNewLine();
-					break;
-				}
+				CommandLine discard;
+				ReadSerialStrUntilNewLine(discard);
+				break;
 			}
 		}
-		else if (kbString[0] == 'A')
+	}
+	else if (kbString[0] == 'A')
+	{
+		LOG_INFO("Processing 'D' Command");
+		LOG_INFO("initColorSelector");
+		initColorSelector();
+		LOG_INFO("initIdlerPosition");
+		initIdlerPosition();
+		LOG_INFO("T0");
+		toolChange('0');
+		delay(2000);
+		LOG_INFO("T1");
+		toolChange('1');
+		delay(2000);
+		LOG_INFO("T2");
+		toolChange('2');
+		delay(2000);
+		LOG_INFO("T3");
+		toolChange('3');
+		delay(2000);
+		LOG_INFO("T4");
+		toolChange('4');
+		delay(2000);
+		LOG_INFO("T0");
+		toolChange('0');
+		delay(2000);
+
+		if (idlerStatus == QUICKPARKED)
 		{
-			println_log(F("Processing 'D' Command"));
-			println_log(F("initColorSelector"));
-			initColorSelector();
-			println_log(F("initIdlerPosition"));
-			initIdlerPosition();
-			println_log(F("T0"));
-			toolChange('0');
-			delay(2000);
-			println_log(F("T1"));
-			toolChange('1');
-			delay(2000);
-			println_log(F("T2"));
-			toolChange('2');
-			delay(2000);
-			println_log(F("T3"));
-			toolChange('3');
-			delay(2000);
-			println_log(F("T4"));
-			toolChange('4');
-			delay(2000);
-			println_log(F("T0"));
-			toolChange('0');
-			delay(2000);
-
-			if (idlerStatus == QUICKPARKED)
-			{
-				quickUnParkIdler(); // un-park the idler from a quick park
-			}
-			if (idlerStatus == INACTIVE)
-			{
-				unParkIdler(); // turn on the idler motor
-			}
-			unloadFilamentToFinda(); //unload the filament
-			parkIdler();			 // park the idler motor and turn it off
+			quickUnParkIdler(); // un-park the idler from a quick park
+		}
+		if (idlerStatus == INACTIVE)
+		{
+			unParkIdler(); // turn on the idler motor
 		}
+		unloadFilamentToFinda(); //unload the filament
+		parkIdler();			 // park the idler motor and turn it off
+	}
 #endif
+	if (kbString[0] == 'K')
+	{
+		// calibration: 'K' show, 'K<name>=<value>' change, 'KW' store, 'KL' reload, 'KD' defaults
+		processCalibrationCommand(kbString.c_str() + 1);
+	}
+	if (kbString[0] == 'R')
+	{
+		// 'R' : RAM usage and stack high-water mark
+		ram_report();
+	}
+	if (kbString[0] == 'H')
+	{
+		// 'H' : lifetime counters and phase histograms, 'HR' : clear them
+		if (kbString[1] == 'R')
+		{
+			stats_reset();
+		}
+		stats_report();
+	}
+	if (kbString[0] == 'M')
+	{
+		// 'M' : receive-to-ack latency of the printer commands, 'MR' : print and reset them
+		latency_report();
+		if (kbString[1] == 'R')
+		{
+			latency_reset();
+		}
+	}
+#ifdef EVENT_TRACE
+	if (kbString[0] == 'E')
+	{
+		// 'E' : event trace (see trace.h and mmu_trace.py), 'ER' : dump and clear it
+		trace_dump();
+		if (kbString[1] == 'R')
+		{
+			trace_clear();
+		}
 	}
 #endif
 
-} // end of infinite loop
+	if (motion)
+	{
+		recordMechanicalState();
+	}
+}
+#endif
+
+/*****************************************************
+ *
+ * Store the current positions as the clean mechanical state (end of a motion command)
+ *
+ *****************************************************/
+void recordMechanicalState()
+{
+	mechState.filamentSelection = filamentSelection;
+	mechState.idlerStatus = idlerStatus;
+	mechState.loaded = isFilamentLoadedPinda() ? 1 : 0;
+	mechState.trackToolChanges = trackToolChanges;
+	mechState.bearingPosition = oldBearingPosition;
+	mechState.selectorPosition = currentPosition;
+	mechstate_motion_end();
+}
+
+/*****************************************************
+ *
+ * Restore the positions of the last clean shutdown instead of homing
+ * returns false (cold boot needed) without a clean record or if the sensors disagree with it
+ *
+ *****************************************************/
+bool warmBoot()
+{
+	if (!mechstate_load() || !mechState.clean)
+	{
+		LOG_INFO("Cold boot: no clean mechanical state");
+		return false;
+	}
+	if ((mechState.filamentSelection > 4) || (mechState.idlerStatus > QUICKPARKED))
+	{
+		LOG_WARN("Cold boot: stored mechanical state out of range");
+		return false;
+	}
+	// plausibility: FINDA as stored, the filament switch only with filament in the MMU,
+	// the selector away from its endstop (none of the five slots touches it)
+	if ((isFilamentLoadedPinda() ? 1 : 0) != mechState.loaded)
+	{
+		LOG_WARN("Cold boot: FINDA does not match the stored state");
+		return false;
+	}
+	if (!mechState.loaded && isFilamentLoadedtoExtruder())
+	{
+		LOG_WARN("Cold boot: filament switch active without filament in the FINDA");
+		return false;
+	}
+	if (sensorRead(colorSelectorEnstop) == LOW)
+	{
+		LOG_WARN("Cold boot: selector on its endstop");
+		return false;
+	}
+
+	filamentSelection = mechState.filamentSelection;
+	currentExtruder = '0' + mechState.filamentSelection;
+	idlerStatus = mechState.idlerStatus;
+	trackToolChanges = mechState.trackToolChanges;
+	oldBearingPosition = mechState.bearingPosition;
+	currentPosition = mechState.selectorPosition;
+	if (idlerStatus != INACTIVE)
+	{
+		// the idler was left engaged (waiting for 'C'), hold it there
+		motorEnable(idlerEnablePin, ENABLE);
+	}
+	return true;
+}
+
+/*****************************************************
+ *
+ * Finish a tool change that was cut short by a reset (see journal.h)
+ * - the new filament reached the extruder: resume, as if the swap had completed
+ * - otherwise: roll back, the filament in the MMU goes back behind the selector
+ * homes the axes, returns false if there was nothing to recover
+ *
+ *****************************************************/
+bool recoverToolChange()
+{
+	Journal journal;
+	int slot;
+
+	if (!journal_load(&journal) || (journal.phase == JOURNAL_NONE))
+	{
+		return false;
+	}
+	LOG_WARN("Tool change %d -> %d interrupted in phase %d", (int)journal.from, (int)journal.to, (int)journal.phase);
+
+	initIdlerPosition();
+	if ((journal.phase == JOURNAL_FEED) && isFilamentLoadedtoExtruder())
+	{
+		// the selector had reached its slot before the feed started
+		LOG_INFO("Resuming: filament %d is in the extruder", (int)journal.to);
+		filamentSelection = journal.to;
+		currentExtruder = '0' + journal.to;
+		currentPosition = selectorAbsPos[journal.to];
+		repeatTCmdFlag = INACTIVE;
+	}
+	else
+	{
+		slot = (journal.phase == JOURNAL_FEED) ? journal.to : journal.from;
+		if (isFilamentLoadedPinda())
+		{
+			LOG_INFO("Rolling back: unloading filament %d", slot);
+			idlerSelector('0' + slot);
+			unloadFilamentToFinda();
+			parkIdler();
+		}
+		initColorSelector();
+		currentPosition = 0;
+		filamentSelection = 0; // where the homing left the idler and the selector
+		currentExtruder = '0';
+	}
+	journal_write(JOURNAL_NONE, journal.from, journal.to);
+	recordMechanicalState();
+	return true;
+}
+
+/*****************************************************
+ *
+ * Build the idler / selector position tables from the calibration offsets
+ *
+ *****************************************************/
+void applyCalibration()
+{
+	for (int i = 0; i < 5; i++)
+	{
+		bearingAbsPos[i] = IDLERSTEPSIZE * i + calibration.idlerOffset[i];
+		selectorAbsPos[i] = CSSTEPS * i + calibration.csOffset[i];
+	}
+}
+
+/*****************************************************
+ *
+ * 'K' debug console command
+ *
+ *****************************************************/
+void processCalibrationCommand(const char *args)
+{
+	char name[16];
+	const char *equal;
+	char *end;
+	long value;
+
+	if ((args[0] == 'W') && (args[1] < ' '))
+	{
+		calibration_commit();
+	}
+	else if ((args[0] == 'L') && (args[1] < ' '))
+	{
+		calibration_load();
+	}
+	else if ((args[0] == 'D') && (args[1] < ' '))
+	{
+		calibration_defaults();
+	}
+	else if ((equal = strchr(args, '=')) != NULL)
+	{
+		if ((equal - args) >= (int)sizeof(name))
+		{
+			LOG_WARN("K: unknown calibration value");
+			return;
+		}
+		memcpy(name, args, equal - args);
+		name[equal - args] = 0;
+		value = strtol(equal + 1, &end, 10);
+		if ((end == equal + 1) || !calibration_set(name, value))
+		{
+			LOG_WARN("K: invalid calibration value");
+			return;
+		}
+	}
+	applyCalibration();
+	calibration_report();
+}
 
 /***************************************************************************************************************
  ***************************************************************************************************************
@@ -305,195 +597,404 @@ void Application::loop()
  * Serial read until new line
  * 
  *****************************************************/
-String ReadSerialStrUntilNewLine()
+void ReadSerialStrUntilNewLine(CommandLine &str)
 {
-	String str = "";
 	char c = -1;
+
+	str.clear();
 	while ((c != '\n') && (c != '\r'))
 	{
-		if (Serial.available())
+		if (consoleAvailable())
 		{
-			c = char(Serial.read());
+			c = char(consoleRead());
 			if (c != -1)
 			{
-				str += c;
+				str.append(c);
 			}
 		}
 	}
-	return str;
 }
 
 /*****************************************************
  *
- * Handle command from the Printer
+ * Serial1 receive task: collects a command line without blocking
+ * the line is complete on '\n', or after SERIAL1_LINE_TIMEOUT ms without a new byte
+ * 
+ *****************************************************/
+static CommandLine printerLine;
+static bool printerLineReady = false;
+static unsigned long printerLastByte;
+
+bool serial1Ready()
+{
+	// a line waiting for dispatch holds the next bytes back in the UART buffer
+	if (printerLineReady)
+	{
+		return false;
+	}
+	return (printerAvailable() > 0) || (printerLine.length() && ((millis() - printerLastByte) >= SERIAL1_LINE_TIMEOUT));
+}
+
+void serial1Receive()
+{
+	char c;
+
+	while (printerAvailable() > 0)
+	{
+		if (!printerLine.length())
+		{
+			latency_begin(Serial1.peek());
+			TRACE_EVENT(TRACE_COMMAND, Serial1.peek());
+		}
+		c = char(Serial1.read());
+		RECORD_RX(c);
+		printerLastByte = millis();
+		if (c == '\n')
+		{
+			printerLineReady = true;
+			break;
+		}
+		printerLine.append(c);
+	}
+	if (printerLine.length() && ((millis() - printerLastByte) >= SERIAL1_LINE_TIMEOUT))
+	{
+		printerLineReady = true; // partial line, give it to the parser as before
+	}
+}
+
+bool dispatchReady()
+{
+	// the next command waits for the end of the running one
+	return printerLineReady && !motionCommand;
+}
+
+void dispatchCommand()
+{
+	processPrinterCommand(printerLine);
+	printerLine.clear();
+	printerLineReady = false;
+}
+
+/*****************************************************
+ *
+ * motion task: the long part of a T, C, U or L command runs as a protothread and
+ * the other tasks get a turn at each of its wait points; the ack goes out at the end
+ * 
+ *****************************************************/
+static struct pt motionPt;
+static char motionArg;
+
+void startMotion(char cmd, char arg)
+{
+	motionCommand = cmd;
+	motionArg = arg;
+	PT_INIT(&motionPt);
+}
+
+bool motionReady()
+{
+	return motionCommand != 0;
+}
+
+PT_THREAD(motionThread(struct pt *pt))
+{
+	static struct pt child;
+	static bool acknowledge;
+
+	PT_BEGIN(pt);
+	acknowledge = true;
+	if (motionCommand == 'T')
+	{
+		PT_SPAWN(pt, &child, toolChangeThread(&child, motionArg));
+	}
+	else if (motionCommand == 'C')
+	{
+		// no ack when the filament did not get to the extruder (or for a repeated C)
+		PT_SPAWN(pt, &child, filamentLoadWithBondTechGearThread(&child, &acknowledge));
+	}
+	else if (motionCommand == 'U')
+	{
+		PT_SPAWN(pt, &child, unloadFilamentToFindaThread(&child));
+		parkIdler();
+		// parkIdler() only returns once the idler has reached its park position
+		LOG_INFO("U: Sending Filament Unload Acknowledge to MK3");
+	}
+	else if (motionCommand == 'L')
+	{
+		LOG_INFO("L: Moving the bearing idler");
+		idlerSelector(motionArg); // move the filament selector stepper motor to the right spot
+		LOG_INFO("L: Moving the color selector");
+		PT_SPAWN(pt, &child, colorSelectorThread(&child, motionArg)); // the operator may have to clear the way
+		LOG_INFO("L: Loading the Filament");
+		PT_SPAWN(pt, &child, loadFilamentToFindaThread(&child));
+		parkIdler(); // turn off the idler roller
+		// parkIdler() only returns once the idler has reached its park position
+		LOG_INFO("L: Sending Filament Load Acknowledge to MK3");
+	}
+	if (acknowledge)
+	{
+		ackCommand(motionCommand);
+	}
+	recordMechanicalState();
+	motionCommand = 0;
+	PT_END(pt);
+}
+
+void motionStep()
+{
+	motionThread(&motionPt);
+}
+
+#ifdef SERIAL_DEBUG
+/*****************************************************
+ *
+ * debug console receive task, the console commands run from it directly
+ * 
+ *****************************************************/
+bool consoleReady()
+{
+	// keys typed during a motion are for fixTheProblemThread()
+	return (consoleAvailable() > 0) && !motionCommand && !problemPending;
+}
+
+void consoleReceive()
+{
+	static CommandLine kbString;
+	char c;
+
+	while (consoleAvailable() > 0)
+	{
+		c = char(consoleRead());
+		kbString.append(c);
+		if ((c == '\n') || (c == '\r'))
+		{
+			processConsoleCommand(kbString);
+			kbString.clear();
+			break;
+		}
+	}
+}
+#endif
+
+/*****************************************************
+ *
+ * sensor monitoring task: reports the FINDA and filament switch changes between commands
+ * 
+ *****************************************************/
+void monitorSensors()
+{
+	static int8_t lastFinda = -1;
+	static int8_t lastSwitch = -1;
+	int8_t finda = isFilamentLoadedPinda() ? 1 : 0;
+	int8_t filamentSwitchState = isFilamentLoadedtoExtruder() ? 1 : 0;
+
+	if ((finda != lastFinda) || (filamentSwitchState != lastSwitch))
+	{
+		LOG_INFO("Sensors: FINDA %d, filament switch %d", (int)finda, (int)filamentSwitchState);
+		lastFinda = finda;
+		lastSwitch = filamentSwitchState;
+	}
+}
+
+/*****************************************************
+ *
+ * display task: no I2C transfer between the steps of a motion, only while it
+ * waits for the operator
+ * 
+ *****************************************************/
+void displayRefresh()
+{
+	if (motionCommand && !problemPending)
+		return;
+	status_refresh();
+}
+
+/*****************************************************
+ *
+ * background maintenance task: counters and flash compaction, never between
+ * the steps of a motion
+ * 
+ *****************************************************/
+void maintenance()
+{
+#ifdef FIELD_RECORDER
+	recorder_idle();
+#endif
+	if (motionCommand)
+		return;
+	stats_idle();
+	storage_idle();
+}
+
+/*****************************************************
+ *
+ * Acknowledge a command to the printer board
  * 
  *****************************************************/
-void checkSerialInterface()
+void ackCommand(char cmd)
 {
-	int cnt;
-	String inputLine;
-	int index;
+	PRINTER_SERIAL.print(F("ok\n"));
+	latency_ack(cmd);
+	TRACE_EVENT(TRACE_ACK, cmd);
+}
 
-	index = 0;
-	if ((cnt = Serial1.available()) > 0)
+/*****************************************************
+ *
+ * Handle a command line from the Printer
+ * 
+ *****************************************************/
+void processPrinterCommand(const CommandLine &inputLine)
+{
+	if (inputLine[0] != 'P')
 	{
+		LOG_INFO("MMU Command: %s", inputLine.c_str());
+	}
+	// parse the inbound command
+	unsigned char c1, c2;
+
+	c1 = inputLine[0]; // fetch single characer from the input line
+	c2 = inputLine[1]; // fetch 2nd character from the input line
+
+	// process commands coming from the mk3 controller
+	//***********************************************************************************
+	// Commands still to be implemented:
+	// X0 (MMU Reset)
+	// F0 (Filament type select),
+	// E0->E4 (Eject Filament)
+	// R0 (recover from eject)
+	//***********************************************************************************
+	// the positions are not known while the motors run: a reset until the end of
+	// the command means a cold boot
+	bool motion = (c1 == 'T') || (c1 == 'C') || (c1 == 'U') || (c1 == 'L');
+	if (motion)
+	{
+		mechstate_motion_begin();
+	}
 
-		inputLine = Serial1.readString(); // fetch the command from the mmu2 serial input interface
-
-		if (inputLine[0] != 'P')
+	switch (c1)
+	{
+	case 'T':
+		// request for idler and selector based on filament number
+		if ((c2 >= '0') && (c2 <= '4'))
 		{
-			print_log(F("MMU Command: "));
-			println_log(inputLine);
+			startMotion(c1, c2); // acknowledged at the end
 		}
-	process_more_commands: // parse the inbound command
-		unsigned char c1, c2;
-
-		c1 = inputLine[index++]; // fetch single characer from the input line
-		c2 = inputLine[index++]; // fetch 2nd character from the input line
-		inputLine[index++];		 // carriage return
-
-		// process commands coming from the mk3 controller
-		//***********************************************************************************
-		// Commands still to be implemented:
-		// X0 (MMU Reset)
-		// F0 (Filament type select),
-		// E0->E4 (Eject Filament)
-		// R0 (recover from eject)
-		//***********************************************************************************
-		switch (c1)
+		else
 		{
-		case 'T':
-			// request for idler and selector based on filament number
-			if ((c2 >= '0') && (c2 <= '4'))
-			{
-				toolChange(c2);
-			}
-			else
-			{
-				println_log(F("T: Invalid filament Selection"));
-			}
+			LOG_WARN("T: Invalid filament Selection");
+			ackCommand(c1); // send command acknowledge back to mk3 controller
+		}
+		break;
+	case 'C':
+		// move filament from selector ALL the way to printhead
+		startMotion(c1, c2); // acknowledged at the end if the filament got there
+		break;
 
-			Serial1.print(F("ok\n")); // send command acknowledge back to mk3 controller
-			break;
-		case 'C':
-			// move filament from selector ALL the way to printhead
-			if (filamentLoadWithBondTechGear())
-				Serial1.print(F("ok\n"));
-			break;
+	case 'U':
+		// request for filament unload
+		LOG_INFO("U: Filament Unload Selected");
+		if (idlerStatus == QUICKPARKED)
+		{
+			quickUnParkIdler(); // un-park the idler from a quick park
+		}
+		if (idlerStatus == INACTIVE)
+		{
+			unParkIdler(); // turn on the idler motor
+		}
+		if ((c2 >= '0') && (c2 <= '4'))
+		{
+			startMotion(c1, c2); // unload, park and acknowledge
+		}
+		else
+		{
+			LOG_WARN("U: Invalid filament Unload Requested");
+			ackCommand(c1);
+		}
+		break;
+	case 'L':
+		// request for filament load
+		LOG_INFO("L: Filament Load Selected");
+		if (idlerStatus == QUICKPARKED)
+		{
+			quickUnParkIdler(); // un-park the idler from a quick park
+		}
+		if (idlerStatus == INACTIVE)
+		{
+			unParkIdler(); // turn on the idler motor
+		}
+		if (colorSelectorStatus == INACTIVE)
+			activateColorSelector(); // turn on the color selector motor
+		if ((c2 >= '0') && (c2 <= '4'))
+		{
+			startMotion(c1, c2); // select, load, park and acknowledge
+		}
+		else
+		{
+			LOG_ERROR("Error: Invalid Filament Number Selected");
+		}
+		break;
 
-		case 'U':
-			// request for filament unload
-			println_log(F("U: Filament Unload Selected"));
-			if (idlerStatus == QUICKPARKED)
-			{
-				quickUnParkIdler(); // un-park the idler from a quick park
-			}
-			if (idlerStatus == INACTIVE)
-			{
-				unParkIdler(); // turn on the idler motor
-			}
-			if ((c2 >= '0') && (c2 <= '4'))
-			{
-				unloadFilamentToFinda();
-				parkIdler();
-				println_log(F("U: Sending Filament Unload Acknowledge to MK3"));
-				delay(200);
-				Serial1.print(F("ok\n"));
-			}
-			else
-			{
-				println_log(F("U: Invalid filament Unload Requested"));
-				delay(200);
-				Serial1.print(F("ok\n"));
-			}
-			break;
-		case 'L':
-			// request for filament load
-			println_log(F("L: Filament Load Selected"));
-			if (idlerStatus == QUICKPARKED)
-			{
-				quickUnParkIdler(); // un-park the idler from a quick park
-			}
-			if (idlerStatus == INACTIVE)
-			{
-				unParkIdler(); // turn on the idler motor
-			}
-			if (colorSelectorStatus == INACTIVE)
-				activateColorSelector(); // turn on the color selector motor
-			if ((c2 >= '0') && (c2 <= '4'))
-			{
-				println_log(F("L: Moving the bearing idler"));
-				idlerSelector(c2); // move the filament selector stepper motor to the right spot
-				println_log(F("L: Moving the color selector"));
-				colorSelector(c2); // move the color Selector stepper Motor to the right spot
-				println_log(F("L: Loading the Filament"));
-				loadFilamentToFinda();
-				parkIdler(); // turn off the idler roller
-				println_log(F("L: Sending Filament Load Acknowledge to MK3"));
-				delay(200);
-				Serial1.print(F("ok\n"));
-			}
-			else
-			{
-				println_log(F("Error: Invalid Filament Number Selected"));
-			}
+	case 'S':
+		// request for firmware version
+		switch (c2)
+		{
+		case '0':
+			LOG_INFO("S: Sending back OK to MK3");
+			ackCommand(c1);
 			break;
-
-		case 'S':
-			// request for firmware version
-			switch (c2)
-			{
-			case '0':
-				println_log(F("S: Sending back OK to MK3"));
-				Serial1.print(F("ok\n"));
-				break;
-			case '1':
-				println_log(F("S: FW Version Request"));
-				Serial1.print(FW_VERSION);
-				Serial1.print(F("ok\n"));
-				break;
-			case '2':
-				println_log(F("S: Build Number Request"));
-				println_log(F("Initial Communication with MK3 Controller: Successful"));
-				Serial1.print(FW_BUILDNR);
-				Serial1.print(F("ok\n"));
-				break;
-			default:
-				println_log(F("S: Unable to process S Command"));
-				break;
-			}
+		case '1':
+			LOG_INFO("S: FW Version Request");
+			PRINTER_SERIAL.print(FW_VERSION);
+			ackCommand(c1);
 			break;
-		case 'P':
-			// check FINDA status
-			if (!isFilamentLoadedPinda())
-			{
-				Serial1.print(F("0"));
-			}
-			else
-			{
-				Serial1.print(F("1"));
-			}
-			Serial1.print(F("ok\n"));
+		case '2':
+			LOG_INFO("S: Build Number Request");
+			LOG_INFO("Initial Communication with MK3 Controller: Successful");
+			PRINTER_SERIAL.print(FW_BUILDNR);
+			ackCommand(c1);
 			break;
-		case 'F':
-			// 'F' command is acknowledged but no processing goes on at the moment
-			// will be useful for flexible material down the road
-			println_log(F("Filament Type Selected: "));
-			println_log(c2);
-			Serial1.print(F("ok\n")); // send back OK to the mk3
+		case '3':
+			// not part of the MK3 protocol: free RAM and stack high-water mark, for diagnostics
+			RamInfo ram;
+			ram_info(&ram);
+			PRINTER_SERIAL.print(ram.freeRam);
+			PRINTER_SERIAL.print(F(" "));
+			PRINTER_SERIAL.print(ram.stackPeak);
+			ackCommand(c1);
 			break;
 		default:
-			print_log(F("ERROR: unrecognized command from the MK3 controller"));
-			Serial1.print(F("ok\n"));
-		} // end of switch statement
-
-	} // end of cnt > 0 check
+			LOG_WARN("S: Unable to process S Command");
+			break;
+		}
+		break;
+	case 'P':
+		// check FINDA status
+		if (!isFilamentLoadedPinda())
+		{
+			PRINTER_SERIAL.print(F("0"));
+		}
+		else
+		{
+			PRINTER_SERIAL.print(F("1"));
+		}
+		ackCommand(c1);
+		break;
+	case 'F':
+		// 'F' command is acknowledged but no processing goes on at the moment
+		// will be useful for flexible material down the road
+		LOG_INFO("Filament Type Selected: %c", c2);
+		ackCommand(c1); // send back OK to the mk3
+		break;
+	default:
+		LOG_ERROR("ERROR: unrecognized command from the MK3 controller");
+		ackCommand(c1);
+	} // end of switch statement
 
-	if (index < cnt)
+	if (motion && !motionCommand)
 	{
-		goto process_more_commands;
+		recordMechanicalState(); // done, the started motions record it at their end
 	}
-	// }  // check for early commands
+
 }
 
 /*****************************************************
@@ -501,36 +1002,144 @@ void checkSerialInterface()
  * this routine is the common routine called for fixing the filament issues (loading or unloading)
  *
  *****************************************************/
-void fixTheProblem(String statement)
+PT_THREAD(fixTheProblemThread(struct pt *pt, const __FlashStringHelper *statement, uint8_t failure))
 {
-	println_log(F(""));
-	println_log(F("********************* ERROR ************************"));
-	println_log(statement); // report the error to the user
-	println_log(F("********************* ERROR ************************"));
-	println_log(F("Clear the problem and then hit any key to continue "));
-	println_log(F(""));
-	println_log(F("PINDA | EXTRUDER"));
-	isFilamentLoadedPinda() ? print_log(F("ON    | ")) : print_log(F("OFF   | "));
-	isFilamentLoadedtoExtruder() ? println_log(F("ON")) : println_log(F("OFF"));
-	println_log(F(""));
+	static ErrorMessage message;
+
+	PT_BEGIN(pt);
+	TRACE_EVENT(TRACE_PROBLEM, failure);
+	stats_failure(failure);
+
+	message.assign(statement);
+	// the motors are stopped from here on, make sure the whole report gets out
+	log_flush();
+	LOG_ERROR("********************* ERROR ************************");
+	LOG_ERROR("%s", message.c_str()); // report the error to the user
+	LOG_ERROR("********************* ERROR ************************");
+	log_flush();
+	LOG_ERROR("Clear the problem and then hit any key to continue ");
+	LOG_ERROR("PINDA | EXTRUDER");
+	LOG_ERROR("%-5s | %s", isFilamentLoadedPinda() ? "ON" : "OFF", isFilamentLoadedtoExtruder() ? "ON" : "OFF");
 	//FIXME
 	// IF POSSIBLE : 
 	// SYNC COLORSELECTOR
 	// SYNC IDLER
+	status_error(message.c_str());
 	parkIdler();								   // park the idler stepper motor
-	digitalWrite(colorSelectorEnablePin, DISABLE); // turn off the selector stepper motor
+	motorEnable(colorSelectorEnablePin, DISABLE); // turn off the selector stepper motor
 
 #ifdef SERIAL_DEBUG
-	while (!Serial.available())
+	//  wait until key is entered to proceed  (this is to allow for operator intervention)
+	problemPending = true;
+	PT_WAIT_UNTIL(pt, consoleAvailable());
+	while (consoleAvailable())
 	{
-		//  wait until key is entered to proceed  (this is to allow for operator intervention)
+		consoleRead(); // clear the keyboard buffer
 	}
-	Serial.readString(); // clear the keyboard buffer
+	problemPending = false;
 #endif
+	TRACE_EVENT(TRACE_PROBLEM_END, failure);
+	status_error(NULL);
 
 	unParkIdler();								  // put the idler stepper motor back to its' original position
-	digitalWrite(colorSelectorEnablePin, ENABLE); // turn ON the selector stepper motor
+	motorEnable(colorSelectorEnablePin, ENABLE); // turn ON the selector stepper motor
 	delay(1);									  // wait for 1 millisecond
+	PT_END(pt);
+}
+
+/*****************************************************
+ *
+ * body of the blocking wrappers of the protothreads (console, boot recovery):
+ * what the task table runs at their wait points, the display only while the
+ * operator is awaited (see displayRefresh())
+ * 
+ *****************************************************/
+static void blockingWaitPoint()
+{
+	log_drain();
+#ifdef FIELD_RECORDER
+	recorder_drain();
+	recorder_idle(); // the operator may take a while
+#endif
+	if (problemPending)
+		status_refresh();
+}
+
+void fixTheProblem(const __FlashStringHelper *statement, uint8_t failure)
+{
+	struct pt pt;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(fixTheProblemThread(&pt, statement, failure)))
+	{
+		blockingWaitPoint();
+	}
+}
+
+/*****************************************************
+ *
+ * Turn a stepper driver on (ENABLE) or off (DISABLE)
+ * 
+ *****************************************************/
+void motorEnable(uint8_t enablePin, uint8_t state)
+{
+	digitalWrite(enablePin, state);
+	if (enablePin == idlerEnablePin)
+	{
+		TRACE_LEVEL(TRACE_MOTOR_IDLER, state == ENABLE);
+	}
+	else if (enablePin == colorSelectorEnablePin)
+	{
+		TRACE_LEVEL(TRACE_MOTOR_SELECTOR, state == ENABLE);
+	}
+	else
+	{
+		TRACE_LEVEL(TRACE_MOTOR_EXTRUDER, state == ENABLE);
+	}
+}
+
+/*****************************************************
+ *
+ * Read a sensor (FINDA, filament switch, selector endstop)
+ * the field recorder keeps what the firmware saw
+ * 
+ *****************************************************/
+int sensorRead(uint8_t pin)
+{
+	int level = digitalRead(pin);
+
+	RECORD_INPUT(pin, level);
+	return level;
+}
+
+/*****************************************************
+ *
+ * Serial1 and debug console input
+ * the field recorder times a byte when available() first reports it
+ * 
+ *****************************************************/
+int printerAvailable()
+{
+	int count = Serial1.available();
+
+	RECORD_RX_AVAILABLE(count);
+	return count;
+}
+
+int consoleAvailable()
+{
+	int count = Serial.available();
+
+	RECORD_CONSOLE_AVAILABLE(count);
+	return count;
+}
+
+int consoleRead()
+{
+	int c = Serial.read();
+
+	RECORD_CONSOLE(c);
+	return c;
 }
 
 /***************************************************************************************************************
@@ -555,7 +1164,7 @@ void deActivateColorSelector()
 {
 //FIXME : activate it by default
 #ifdef TURNOFFSELECTORMOTOR
-	digitalWrite(colorSelectorEnablePin, DISABLE); // turn off the color selector stepper motor  (nice to do, cuts down on CURRENT utilization)
+	motorEnable(colorSelectorEnablePin, DISABLE); // turn off the color selector stepper motor  (nice to do, cuts down on CURRENT utilization)
 	delay(1);
 	colorSelectorStatus = INACTIVE;
 #endif
@@ -567,23 +1176,29 @@ void deActivateColorSelector()
  *****************************************************/
 void activateColorSelector()
 {
-	digitalWrite(colorSelectorEnablePin, ENABLE);
+	motorEnable(colorSelectorEnablePin, ENABLE);
 	delay(1);
 	colorSelectorStatus = ACTIVE;
 }
 
-void colorSelector(char selection)
+/*****************************************************
+ *
+ * move the selector to a filament (0..4), once the FINDA says the way is clear
+ *
+ *****************************************************/
+PT_THREAD(colorSelectorThread(struct pt *pt, char selection))
 {
+	static struct pt child;
+
+	PT_BEGIN(pt);
 	if ((selection < '0') || (selection > '4'))
 	{
-		println_log(F("colorSelector():  Error, invalid filament selection"));
-		return;
+		LOG_ERROR("colorSelector():  Error, invalid filament selection");
+		PT_EXIT(pt);
 	}
-loop:
-	if (isFilamentLoadedPinda())
+	while (isFilamentLoadedPinda())
 	{
-		fixTheProblem("colorSelector(): Error, filament is present between the MMU2 and the MK3 Extruder:  UNLOAD FILAMENT!!");
-		goto loop;
+		PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("colorSelector(): Error, filament is present between the MMU2 and the MK3 Extruder:  UNLOAD FILAMENT!!"), STATS_FAIL_SELECTOR_BLOCKED));
 	}
 
 	switch (selection)
@@ -641,9 +1256,20 @@ loop:
 		currentPosition = selectorAbsPos[4];
 		break;
 	}
-
+	PT_END(pt);
 } // end of colorSelector routine()
 
+void colorSelector(char selection)
+{
+	struct pt pt;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(colorSelectorThread(&pt, selection)))
+	{
+		blockingWaitPoint();
+	}
+}
+
 /*****************************************************
  *
  * this is the selector motor with the lead screw (final stage of the MMU2 unit)
@@ -652,7 +1278,7 @@ loop:
 void csTurnAmount(int steps, int direction)
 {
 
-	digitalWrite(colorSelectorEnablePin, ENABLE); // turn on the color selector motor
+	motorEnable(colorSelectorEnablePin, ENABLE); // turn on the color selector motor
 	if (direction == CW)
 		digitalWrite(colorSelectorDirPin, LOW); // set the direction for the Color Extruder Stepper Motor
 	else
@@ -661,30 +1287,25 @@ void csTurnAmount(int steps, int direction)
 	// wait 1 milliseconds
 	delayMicroseconds(1500); // changed from 500 to 1000 microseconds on 10.6.18, changed to 1500 on 10.7.18)
 
-#ifdef DEBUG
-	int scount;
-	print_log(F("raw steps: "));
-	println_log(steps);
-
-	scount = steps * STEPSIZE;
-	print_log(F("total number of steps: "));
-	println_log(scount);
-#endif
+	LOG_DEBUG("raw steps: %d", steps);
+	LOG_DEBUG("total number of steps: %u", steps * STEPSIZE);
 
-	for (uint16_t i = 0; i <= (steps * STEPSIZE); i++)
+	uint16_t i;
+	for (i = 0; i <= (steps * STEPSIZE); i++)
 	{
 		digitalWrite(colorSelectorStepPin, HIGH);
 		delayMicroseconds(PINHIGH); // delay for 10 useconds
 		digitalWrite(colorSelectorStepPin, LOW);
 		delayMicroseconds(PINLOW);					// delay for 10 useconds
-		delayMicroseconds(COLORSELECTORMOTORDELAY); // wait for 60 useconds
+		delayMicroseconds(calibration.colorSelectorMotorDelay); // wait for 60 useconds
 		//add enstop
-		if ((digitalRead(colorSelectorEnstop) == LOW) && (direction == CW))
+		if ((sensorRead(colorSelectorEnstop) == LOW) && (direction == CW))
 			break;
 	}
+	stats_steps(STATS_AXIS_SELECTOR, i);
 
 #ifdef TURNOFFSELECTORMOTOR
-	digitalWrite(colorSelectorEnablePin, DISABLE); // turn off the color selector motor
+	motorEnable(colorSelectorEnablePin, DISABLE); // turn off the color selector motor
 #endif
 }
 
@@ -697,11 +1318,11 @@ void csTurnAmount(int steps, int direction)
 void initColorSelector()
 {
 
-	digitalWrite(colorSelectorEnablePin, ENABLE);		   // turn on the stepper motor
+	motorEnable(colorSelectorEnablePin, ENABLE);		   // turn on the stepper motor
 	delay(1);											   // wait for 1 millisecond
 	csTurnAmount(MAXSELECTOR_STEPS, CW);				   // move to the right
 	csTurnAmount(MAXSELECTOR_STEPS + CS_RIGHT_FORCE, CCW); // move all the way to the left
-	digitalWrite(colorSelectorEnablePin, DISABLE);		   // turn off the stepper motor
+	motorEnable(colorSelectorEnablePin, DISABLE);		   // turn off the stepper motor
 }
 
 /*****************************************************
@@ -714,16 +1335,14 @@ void syncColorSelector()
 {
 	int moveSteps;
 
-	digitalWrite(colorSelectorEnablePin, ENABLE); // turn on the selector stepper motor
+	motorEnable(colorSelectorEnablePin, ENABLE); // turn on the selector stepper motor
 	delay(1);									  // wait for 1 millecond
 
-	print_log(F("syncColorSelelector()   current Filament selection: "));
-	println_log(filamentSelection);
+	LOG_INFO("syncColorSelelector()   current Filament selection: %d", filamentSelection);
 
 	moveSteps = MAXSELECTOR_STEPS - selectorAbsPos[filamentSelection];
 
-	print_log(F("syncColorSelector()   moveSteps: "));
-	println_log(moveSteps);
+	LOG_INFO("syncColorSelector()   moveSteps: %d", moveSteps);
 
 	csTurnAmount(moveSteps, CW);						   // move all the way to the right
 	csTurnAmount(MAXSELECTOR_STEPS + CS_RIGHT_FORCE, CCW); // move all the way to the left
@@ -748,12 +1367,12 @@ void syncColorSelector()
 void initIdlerPosition()
 {
 
-	digitalWrite(idlerEnablePin, ENABLE); // turn on the roller bearing motor
+	motorEnable(idlerEnablePin, ENABLE); // turn on the roller bearing motor
 	delay(1);
 	oldBearingPosition = 125; // points to position #1
 	idlerturnamount(MAXROLLERTRAVEL, CW);
 	idlerturnamount(MAXROLLERTRAVEL, CCW); // move the bearings out of the way
-	digitalWrite(idlerEnablePin, DISABLE); // turn off the idler roller bearing motor
+	motorEnable(idlerEnablePin, DISABLE); // turn off the idler roller bearing motor
 
 	filamentSelection = 0; // keep track of filament selection (0,1,2,3,4))
 	currentExtruder = '0';
@@ -770,25 +1389,18 @@ void idlerSelector(char filament)
 	int newBearingPosition;
 	int newSetting;
 
-#ifdef DEBUG
-	print_log(F("idlerSelector(): Filament Selected: "));
-	println_log(filament);
-#endif
+	LOG_DEBUG("idlerSelector(): Filament Selected: %c", filament);
 
-	digitalWrite(extruderEnablePin, ENABLE);
+	motorEnable(extruderEnablePin, ENABLE);
 	if ((filament < '0') || (filament > '4'))
 	{
-		println_log(F("idlerSelector() ERROR, invalid filament selection"));
-		print_log(F("idlerSelector() filament: "));
-		println_log(filament);
+		LOG_ERROR("idlerSelector() ERROR, invalid filament selection");
+		LOG_ERROR("idlerSelector() filament: %c", filament);
 		return;
 	}
 
-#ifdef DEBUG
-	print_log(F("Old Idler Roller Bearing Position:"));
-	println_log(oldBearingPosition);
-	println_log(F("Moving filament selector"));
-#endif
+	LOG_DEBUG("Old Idler Roller Bearing Position:%d", oldBearingPosition);
+	LOG_DEBUG("Moving filament selector");
 
 	switch (filament)
 	{
@@ -818,7 +1430,7 @@ void idlerSelector(char filament)
 		currentExtruder = '4';
 		break;
 	default:
-		println_log(F("idlerSelector(): ERROR, Invalid Idler Bearing Position"));
+		LOG_ERROR("idlerSelector(): ERROR, Invalid Idler Bearing Position");
 		break;
 	}
 
@@ -837,7 +1449,7 @@ void idlerSelector(char filament)
  *****************************************************/
 void idlerturnamount(int steps, int dir)
 {
-	digitalWrite(idlerEnablePin, ENABLE); // turn on motor
+	motorEnable(idlerEnablePin, ENABLE); // turn on motor
 	digitalWrite(idlerDirPin, dir);
 	delay(1); // wait for 1 millisecond
 
@@ -848,8 +1460,9 @@ void idlerturnamount(int steps, int dir)
 		delayMicroseconds(PINHIGH); // delay for 10 useconds
 		digitalWrite(idlerStepPin, LOW);
 		//delayMicroseconds(PINLOW);               // delay for 10 useconds
-		delayMicroseconds(IDLERMOTORDELAY);
+		delayMicroseconds(calibration.idlerMotorDelay);
 	}
+	stats_steps(STATS_AXIS_IDLER, steps * STEPSIZE);
 } // end of idlerturnamount() routine
 
 /***************************************************************************************************************
@@ -869,18 +1482,20 @@ void idlerturnamount(int steps, int dir)
  *****************************************************/
 void feedFilament(unsigned int steps, int stoptoextruder)
 {
-	for (unsigned int i = 0; i <= steps; i++)
+	unsigned int i;
+	for (i = 0; i <= steps; i++)
 	{
 		digitalWrite(extruderStepPin, HIGH);
 		delayMicroseconds(PINHIGH); // delay for 10 useconds
 		digitalWrite(extruderStepPin, LOW);
 		delayMicroseconds(PINLOW); // delay for 10 useconds
 
-		delayMicroseconds(EXTRUDERMOTORDELAY); // wait for 400 useconds
+		delayMicroseconds(calibration.extruderMotorDelay); // wait for 400 useconds
 		//delay(delayValue);           // wait for 30 milliseconds
 		if ((stoptoextruder) && isFilamentLoadedtoExtruder())
 			break;
 	}
+	stats_steps(STATS_AXIS_EXTRUDER, i);
 }
 
 /***************************************************************************************************************
@@ -899,7 +1514,8 @@ void feedFilament(unsigned int steps, int stoptoextruder)
 int isFilamentLoadedPinda()
 {
 	int findaStatus;
-	findaStatus = digitalRead(findaPin);
+	findaStatus = sensorRead(findaPin);
+	TRACE_LEVEL(TRACE_FINDA, findaStatus);
 	return (findaStatus);
 }
 
@@ -911,7 +1527,8 @@ int isFilamentLoadedPinda()
 bool isFilamentLoadedtoExtruder()
 {
 	int fStatus;
-	fStatus = digitalRead(filamentSwitch);
+	fStatus = sensorRead(filamentSwitch);
+	TRACE_LEVEL(TRACE_SWITCH, fStatus == filamentSwitchON);
 	return (fStatus == filamentSwitchON);
 }
 
@@ -928,36 +1545,48 @@ bool isFilamentLoadedtoExtruder()
  * Load the Filament using the FINDA and go back to MMU
  * 
  *****************************************************/
-void loadFilamentToFinda()
+PT_THREAD(loadFilamentToFindaThread(struct pt *pt))
 {
-	unsigned long startTime, currentTime;
+	static unsigned long startTime;
+	static struct pt child;
 
-	digitalWrite(extruderEnablePin, ENABLE);
+	PT_BEGIN(pt);
+	motorEnable(extruderEnablePin, ENABLE);
 	digitalWrite(extruderDirPin, CCW); // set the direction of the MMU2 extruder motor
 	delay(1);
 
 	startTime = millis();
 
-loop:
-	currentTime = millis();
-	if ((currentTime - startTime) > 10000)
-	{ // 10 seconds worth of trying to load the filament
-		fixTheProblem("UNLOAD FILAMENT ERROR:   timeout error, filament is not loaded to the FINDA sensor");
-		startTime = millis(); // reset the start time clock
-	}
-
-	// go 144 steps (1 mm) and then check the finda status
-	feedFilament(STEPSPERMM, STOP_AT_EXTRUDER);
+	do
+	{
+		if ((millis() - startTime) > 10000)
+		{ // 10 seconds worth of trying to load the filament
+			PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("UNLOAD FILAMENT ERROR:   timeout error, filament is not loaded to the FINDA sensor"), STATS_FAIL_LOAD_FINDA));
+			startTime = millis(); // reset the start time clock
+		}
 
-	// keep feeding the filament until the pinda sensor triggers
-	if (!isFilamentLoadedPinda())
-		goto loop;
+		// go 144 steps (1 mm) and then check the finda status
+		feedFilament(STEPSPERMM, STOP_AT_EXTRUDER);
+		PT_YIELD(pt);
+	} while (!isFilamentLoadedPinda()); // keep feeding the filament until the pinda sensor triggers
 	//
 	// for a filament load ... need to get the filament out of the selector head !!
 	//
 	digitalWrite(extruderDirPin, CW); // back the filament away from the selector
 	// after hitting the FINDA sensor, back away by UNLOAD_LENGTH_BACK_COLORSELECTOR mm
-	feedFilament(STEPSPERMM * UNLOAD_LENGTH_BACK_COLORSELECTOR, IGNORE_STOP_AT_EXTRUDER);
+	feedFilament(STEPSPERMM * calibration.unloadLengthBack, IGNORE_STOP_AT_EXTRUDER);
+	PT_END(pt);
+}
+
+void loadFilamentToFinda()
+{
+	struct pt pt;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(loadFilamentToFindaThread(&pt)))
+	{
+		blockingWaitPoint();
+	}
 }
 
 /*****************************************************
@@ -965,59 +1594,68 @@ loop:
  * unload Filament using the FINDA sensor and push it in the MMU
  * 
  *****************************************************/
-void unloadFilamentToFinda()
+PT_THREAD(unloadFilamentToFindaThread(struct pt *pt))
 {
-	unsigned long startTime, currentTime, startTime1;
+	static unsigned long startTime, startTime1;
+	static struct pt child;
+
+	PT_BEGIN(pt);
 	// if the filament is already unloaded, do nothing
 	if (!isFilamentLoadedPinda())
 	{
-		println_log(F("unloadFilamentToFinda():  filament already unloaded"));
-		return;
+		LOG_INFO("unloadFilamentToFinda():  filament already unloaded");
+		PT_EXIT(pt);
 	}
 
-	digitalWrite(extruderEnablePin, ENABLE); // turn on the extruder motor
+	motorEnable(extruderEnablePin, ENABLE); // turn on the extruder stepper motor
 	digitalWrite(extruderDirPin, CW);		 // set the direction of the MMU2 extruder motor
 	delay(1);
 
 	startTime = millis();
 	startTime1 = millis();
 
-loop:
-
-	currentTime = millis();
-
-	// read the filament switch (on the top of the mk3 extruder)
-	if (isFilamentLoadedtoExtruder())
+	do
 	{
-		// filament Switch is still ON, check for timeout condition
-		if ((currentTime - startTime1) > 2000)
-		{ // has 2 seconds gone by ?
-			fixTheProblem("unloadFilamentToFinda(): UNLOAD FILAMENT ERROR: filament not unloading properly, stuck in mk3 head");
-			startTime1 = millis();
+		// read the filament switch (on the top of the mk3 extruder)
+		if (isFilamentLoadedtoExtruder())
+		{
+			// filament Switch is still ON, check for timeout condition
+			if ((millis() - startTime1) > 2000)
+			{ // has 2 seconds gone by ?
+				PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("unloadFilamentToFinda(): UNLOAD FILAMENT ERROR: filament not unloading properly, stuck in mk3 head"), STATS_FAIL_UNLOAD_EXTRUDER));
+				startTime1 = millis();
+			}
 		}
-	}
-	else
-	{
-		// check for timeout waiting for FINDA sensor to trigger
-		if ((currentTime - startTime) > TIMEOUT_LOAD_UNLOAD)
+		else
 		{
-			// 10 seconds worth of trying to unload the filament
-			fixTheProblem("unloadFilamentToFinda(): UNLOAD FILAMENT ERROR: filament is not unloading properly, stuck between mk3 and mmu2");
-			startTime = millis(); // reset the start time
+			// check for timeout waiting for FINDA sensor to trigger
+			if ((millis() - startTime) > TIMEOUT_LOAD_UNLOAD)
+			{
+				// 10 seconds worth of trying to unload the filament
+				PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("unloadFilamentToFinda(): UNLOAD FILAMENT ERROR: filament is not unloading properly, stuck between mk3 and mmu2"), STATS_FAIL_UNLOAD_BOWDEN));
+				startTime = millis(); // reset the start time
+			}
 		}
-	}
 
-	feedFilament(STEPSPERMM, IGNORE_STOP_AT_EXTRUDER); // 1mm and then check the pinda status
-
-	// keep unloading until we hit the FINDA sensor
-	if (isFilamentLoadedPinda())
-	{
-		goto loop;
-	}
+		feedFilament(STEPSPERMM, IGNORE_STOP_AT_EXTRUDER); // 1mm and then check the pinda status
+		PT_YIELD(pt);
+	} while (isFilamentLoadedPinda()); // keep unloading until we hit the FINDA sensor
 
 	// back the filament away from the selector by UNLOAD_LENGTH_BACK_COLORSELECTOR mm
 	digitalWrite(extruderDirPin, CW);
-	feedFilament(STEPSPERMM * UNLOAD_LENGTH_BACK_COLORSELECTOR, IGNORE_STOP_AT_EXTRUDER);
+	feedFilament(STEPSPERMM * calibration.unloadLengthBack, IGNORE_STOP_AT_EXTRUDER);
+	PT_END(pt);
+}
+
+void unloadFilamentToFinda()
+{
+	struct pt pt;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(unloadFilamentToFindaThread(&pt)))
+	{
+		blockingWaitPoint();
+	}
 }
 
 /***************************************************************************************************************
@@ -1037,7 +1675,7 @@ void parkIdler()
 {
 	int newSetting;
 
-	digitalWrite(idlerEnablePin, ENABLE);
+	motorEnable(idlerEnablePin, ENABLE);
 	delay(1);
 
 	newSetting = MAXROLLERTRAVEL - oldBearingPosition;
@@ -1046,8 +1684,8 @@ void parkIdler()
 	idlerturnamount(newSetting, CCW); // move the bearing roller out of the way
 	idlerStatus = INACTIVE;
 
-	digitalWrite(idlerEnablePin, DISABLE);	// turn off the roller bearing stepper motor  (nice to do, cuts down on CURRENT utilization)
-	digitalWrite(extruderEnablePin, DISABLE); // turn off the extruder stepper motor as well
+	motorEnable(idlerEnablePin, DISABLE);	// turn off the roller bearing stepper motor  (nice to do, cuts down on CURRENT utilization)
+	motorEnable(extruderEnablePin, DISABLE); // turn off the extruder stepper motor as well
 }
 
 /*****************************************************
@@ -1058,7 +1696,7 @@ void unParkIdler()
 {
 	int rollerSetting;
 
-	digitalWrite(idlerEnablePin, ENABLE); // turn on (enable) the roller bearing motor
+	motorEnable(idlerEnablePin, ENABLE); // turn on (enable) the roller bearing motor
 	delay(1);							  // wait for 10 useconds
 
 	rollerSetting = MAXROLLERTRAVEL - bearingAbsPos[filamentSelection];
@@ -1067,7 +1705,7 @@ void unParkIdler()
 	idlerturnamount(rollerSetting, CW); // restore the old position
 	idlerStatus = ACTIVE;				// mark the idler as active
 
-	digitalWrite(extruderEnablePin, ENABLE); // turn on (enable) the extruder stepper motor as well
+	motorEnable(extruderEnablePin, ENABLE); // turn on (enable) the extruder stepper motor as well
 }
 
 /*****************************************************
@@ -1079,7 +1717,7 @@ void unParkIdler()
 void quickParkIdler()
 {
 
-	digitalWrite(idlerEnablePin, ENABLE); // turn on the idler stepper motor
+	motorEnable(idlerEnablePin, ENABLE); // turn on the idler stepper motor
 	delay(1);
 
 	idlerturnamount(IDLERSTEPSIZE, CCW);
@@ -1089,7 +1727,7 @@ void quickParkIdler()
 
 	//FIXME : Turn off idler ?
 	//digitalWrite(idlerEnablePin, DISABLE);    // turn off the roller bearing stepper motor  (nice to do, cuts down on CURRENT utilization)
-	digitalWrite(extruderEnablePin, DISABLE); // turn off the extruder stepper motor as well
+	motorEnable(extruderEnablePin, DISABLE); // turn off the extruder stepper motor as well
 }
 
 /*****************************************************
@@ -1106,10 +1744,9 @@ void quickUnParkIdler()
 
 	idlerturnamount(IDLERSTEPSIZE, CW); // restore old position
 
-	print_log(F("quickunparkidler(): oldBearingPosition"));
-	println_log(oldBearingPosition);
+	LOG_INFO("quickunparkidler(): oldBearingPosition%d", oldBearingPosition);
 
-	oldBearingPosition = rollerSetting - IDLERSTEPSIZE; // keep track of the idler position
+	oldBearingPosition = rollerSetting; // keep track of the idler position
 
 	idlerStatus = ACTIVE; // mark the idler as active
 }
@@ -1127,9 +1764,19 @@ void quickUnParkIdler()
  * (T) Tool Change Command - this command is the core command used my the mk3 to drive the mmu2 filament selection
  *
  *****************************************************/
-void toolChange(char selection)
+PT_THREAD(toolChangeThread(struct pt *pt, char selection))
 {
-	int newExtruder;
+	static int newExtruder;
+	static unsigned long startTime;
+	static unsigned long phaseStart;
+	static uint8_t previousSlot;
+	static bool journaled;
+	static struct pt child;
+
+	PT_BEGIN(pt);
+	startTime = millis();
+	previousSlot = filamentSelection;
+	journaled = false;
 
 	++toolChangeCount; // count the number of tool changes
 	++trackToolChanges;
@@ -1140,27 +1787,38 @@ void toolChange(char selection)
 		trackToolChanges = 0;
 	}
 
-	print_log(F("Tool Change Count: "));
-	println_log(toolChangeCount);
+	LOG_INFO("Tool Change Count: %d", toolChangeCount);
 
 	newExtruder = selection - 0x30; // convert ASCII to a number (0-4)
+	stats_swap(newExtruder);
 
 	if (newExtruder == filamentSelection)
 	{ // already at the correct filament selection
 		if (!isFilamentLoadedPinda())
 		{ // no filament loaded
 
-			println_log(F("toolChange: filament not currently loaded, loading ..."));
+			LOG_INFO("toolChange: filament not currently loaded, loading ...");
 
+			journal_write(JOURNAL_SELECT, previousSlot, newExtruder);
+			journaled = true;
+			phaseStart = millis();
+			TRACE_EVENT(TRACE_PHASE_BEGIN, STATS_PHASE_SELECT);
 			idlerSelector(selection); // move the filament selector stepper motor to the right spot
-			colorSelector(selection); // move the color Selector stepper Motor to the right spot
-			filamentLoadToMK3();
+			PT_SPAWN(pt, &child, colorSelectorThread(&child, selection)); // move the color Selector stepper Motor to the right spot
+			TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_SELECT);
+			stats_phase(STATS_PHASE_SELECT, millis() - phaseStart);
+			journal_write(JOURNAL_FEED, previousSlot, newExtruder);
+			phaseStart = millis();
+			TRACE_EVENT(TRACE_PHASE_BEGIN, STATS_PHASE_FEED);
+			PT_SPAWN(pt, &child, filamentLoadToMK3Thread(&child));
+			TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_FEED);
+			stats_phase(STATS_PHASE_FEED, millis() - phaseStart);
 			quickParkIdler();
 			repeatTCmdFlag = INACTIVE; // used to help the 'C' command to feed the filament again
 		}
 		else
 		{
-			println_log(F("toolChange:  filament already loaded to mk3 extruder"));
+			LOG_INFO("toolChange:  filament already loaded to mk3 extruder");
 			repeatTCmdFlag = ACTIVE; // used to help the 'C' command to not feed the filament again
 		}
 	}
@@ -1171,164 +1829,208 @@ void toolChange(char selection)
 		if (isFilamentLoadedPinda())
 		{
 
-			println_log(F("toolChange: Unloading filament"));
+			LOG_INFO("toolChange: Unloading filament");
 
+			journal_write(JOURNAL_UNLOAD, previousSlot, newExtruder);
+			phaseStart = millis();
+			TRACE_EVENT(TRACE_PHASE_BEGIN, STATS_PHASE_UNLOAD);
 			idlerSelector(currentExtruder); // point to the current extruder
-			unloadFilamentToFinda();		// have to unload the filament first
+			PT_SPAWN(pt, &child, unloadFilamentToFindaThread(&child)); // have to unload the filament first
+			TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_UNLOAD);
+			stats_phase(STATS_PHASE_UNLOAD, millis() - phaseStart);
 		}
 
+		journal_write(JOURNAL_SELECT, previousSlot, newExtruder);
+		journaled = true;
+		phaseStart = millis();
+		TRACE_EVENT(TRACE_PHASE_BEGIN, STATS_PHASE_SELECT);
+
 		// reset the color selector stepper motor (gets out of alignment)
 		if (trackToolChanges > TOOLSYNC)
 		{
-			println_log(F("toolChange: Synchronizing the Filament Selector Head"));
+			LOG_INFO("toolChange: Synchronizing the Filament Selector Head");
 			syncColorSelector();
 			//FIXME : add syncIdlerSelector here
 			activateColorSelector(); // turn the color selector motor back on
 			currentPosition = 0;	 // reset the color selector
 			trackToolChanges = 0;
 		}
-#ifdef DEBUG
-		println_log(F("toolChange: Selecting the proper Idler Location"));
-#endif
+		LOG_DEBUG("toolChange: Selecting the proper Idler Location");
 		idlerSelector(selection);
-#ifdef DEBUG
-		println_log(F("toolChange: Selecting the proper Selector Location"));
-#endif
-		colorSelector(selection);
-#ifdef DEBUG
-		println_log(F("toolChange: Loading Filament: loading the new filament to the mk3"));
-#endif
-		filamentLoadToMK3(); // moves the idler and loads the filament
+		LOG_DEBUG("toolChange: Selecting the proper Selector Location");
+		PT_SPAWN(pt, &child, colorSelectorThread(&child, selection));
+		TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_SELECT);
+		stats_phase(STATS_PHASE_SELECT, millis() - phaseStart);
+		LOG_DEBUG("toolChange: Loading Filament: loading the new filament to the mk3");
+		journal_write(JOURNAL_FEED, previousSlot, newExtruder);
+		phaseStart = millis();
+		TRACE_EVENT(TRACE_PHASE_BEGIN, STATS_PHASE_FEED);
+		PT_SPAWN(pt, &child, filamentLoadToMK3Thread(&child)); // moves the idler and loads the filament
+		TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_FEED);
+		stats_phase(STATS_PHASE_FEED, millis() - phaseStart);
 		filamentSelection = newExtruder;
 		currentExtruder = selection;
 		quickParkIdler();
 	}
+	if (journaled)
+	{
+		journal_write(JOURNAL_NONE, previousSlot, newExtruder);
+	}
+	status_swap_time(millis() - startTime);
+	PT_END(pt);
 } // end of ToolChange processing
 
+void toolChange(char selection)
+{
+	struct pt pt;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(toolChangeThread(&pt, selection)))
+	{
+		blockingWaitPoint();
+	}
+}
+
 /*****************************************************
  *
  * this routine is executed as part of the 'T' Command (Load Filament)
  *
  *****************************************************/
-void filamentLoadToMK3()
+PT_THREAD(filamentLoadToMK3Thread(struct pt *pt))
 {
 #ifdef FILAMENTSWITCH_BEFORE_EXTRUDER
-	int flag;
-	int fStatus;
-	int filamentDistance;
+	static int filamentDistance;
 #endif
-	int startTime, currentTime;
+	static unsigned long startTime;
+	static int fed, chunk;
+	static struct pt child;
 
+	PT_BEGIN(pt);
 	if ((currentExtruder < '0') || (currentExtruder > '4'))
 	{
-		println_log(F("filamentLoadToMK3(): fixing current extruder variable"));
+		LOG_WARN("filamentLoadToMK3(): fixing current extruder variable");
 		currentExtruder = '0';
 	}
-#ifdef DEBUG
-	println_log(F("Attempting to move Filament to Print Head Extruder Bondtech Gears"));
+	LOG_DEBUG("Attempting to move Filament to Print Head Extruder Bondtech Gears");
 	//unParkIdler();
-	print_log(F("filamentLoadToMK3():  currentExtruder: "));
-	println_log(currentExtruder);
-#endif
+	LOG_DEBUG("filamentLoadToMK3():  currentExtruder: %c", currentExtruder);
 
 	deActivateColorSelector();
 
-	digitalWrite(extruderEnablePin, ENABLE); // turn on the extruder stepper motor (10.14.18)
+	motorEnable(extruderEnablePin, ENABLE); // turn on the extruder stepper motor (10.14.18)
 	digitalWrite(extruderDirPin, CCW);		 // set extruder stepper motor to push filament towards the mk3
 	delay(1);								 // wait 1 millisecond
 
 	startTime = millis();
 
-loop:
-	feedFilament(STEPSPERMM, IGNORE_STOP_AT_EXTRUDER); // feed 1 mm of filament into the bowden tube
-
-	currentTime = millis();
-
-	// added this timeout feature on 10.4.18 (2 second timeout)
-	if ((currentTime - startTime) > 2000)
+	do
 	{
-		fixTheProblem("FILAMENT LOAD ERROR:  Filament not detected by FINDA sensor, check the selector head in the MMU2");
+		feedFilament(STEPSPERMM, IGNORE_STOP_AT_EXTRUDER); // feed 1 mm of filament into the bowden tube
 
-		startTime = millis();
-	}
-	// keep feeding the filament until the pinda sensor triggers
-	if (!isFilamentLoadedPinda())
-		goto loop;
-loop1:
-	if (isFilamentLoadedtoExtruder())
+		// added this timeout feature on 10.4.18 (2 second timeout)
+		if ((millis() - startTime) > 2000)
+		{
+			PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("FILAMENT LOAD ERROR:  Filament not detected by FINDA sensor, check the selector head in the MMU2"), STATS_FAIL_FEED_FINDA));
+			startTime = millis();
+		}
+		PT_YIELD(pt);
+	} while (!isFilamentLoadedPinda()); // keep feeding the filament until the pinda sensor triggers
+
+	while (isFilamentLoadedtoExtruder())
 	{
 		// switch is active (this is not a good condition)
-		fixTheProblem("FILAMENT LOAD ERROR: Filament Switch in the MK3 is active (see the RED LED), it is either stuck open or there is debris");
-		goto loop1;
+		PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("FILAMENT LOAD ERROR: Filament Switch in the MK3 is active (see the RED LED), it is either stuck open or there is debris"), STATS_FAIL_SWITCH_STUCK));
 	}
 
-	// go DIST_MMU_EXTRUDER mm
-	feedFilament(STEPSPERMM * DIST_MMU_EXTRUDER, STOP_AT_EXTRUDER);
+	// go DIST_MMU_EXTRUDER mm, FEED_YIELD_MM at a time so that the other tasks get their turn
+	for (fed = 0; fed < calibration.distMmuExtruder; fed += chunk)
+	{
+		chunk = calibration.distMmuExtruder - fed;
+		if (chunk > FEED_YIELD_MM)
+			chunk = FEED_YIELD_MM;
+		feedFilament(STEPSPERMM * chunk, STOP_AT_EXTRUDER);
+		if (isFilamentLoadedtoExtruder())
+			break;
+		PT_YIELD(pt);
+	}
 
 #ifdef FILAMENTSWITCH_BEFORE_EXTRUDER
 	// insert until the 2nd filament sensor
-	filamentDistance = DIST_MMU_EXTRUDER;
+	filamentDistance = calibration.distMmuExtruder;
 	startTime = millis();
-	flag = 0;
 
 	// wait until the filament sensor on the mk3 extruder head (microswitch) triggers
-	while (flag == 0)
+	do
 	{
-
-		currentTime = millis();
-		if ((currentTime - startTime) > TIMEOUT_LOAD_UNLOAD)
+		if ((millis() - startTime) > TIMEOUT_LOAD_UNLOAD)
 		{
-			fixTheProblem("FILAMENT LOAD ERROR: Filament not detected by the MK3 filament sensor, check the bowden tube for clogging/binding");
+			PT_SPAWN(pt, &child, fixTheProblemThread(&child, F("FILAMENT LOAD ERROR: Filament not detected by the MK3 filament sensor, check the bowden tube for clogging/binding"), STATS_FAIL_FEED_EXTRUDER));
 			startTime = millis(); // reset the start Time
 		}
 		feedFilament(STEPSPERMM, STOP_AT_EXTRUDER); // step forward 1 mm
 		filamentDistance++;
-		// read the filament switch on the mk3 extruder
-		if (isFilamentLoadedtoExtruder())
-		{
-			flag = 1;
-			print_log(F("Filament distance traveled (mm): "));
-			println_log(filamentDistance);
-		}
-	}
+		PT_YIELD(pt);
+	} while (!isFilamentLoadedtoExtruder()); // read the filament switch on the mk3 extruder
+	LOG_INFO("Filament distance traveled (mm): %d", filamentDistance);
 
 	// feed filament an additional DIST_EXTRUDER_BTGEAR mm to hit the middle of the bondtech gear
 	// go an additional DIST_EXTRUDER_BTGEAR
 	feedFilament(STEPSPERMM * DIST_EXTRUDER_BTGEAR, IGNORE_STOP_AT_EXTRUDER);
 #endif
+	PT_END(pt);
+}
+
+void filamentLoadToMK3()
+{
+	struct pt pt;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(filamentLoadToMK3Thread(&pt)))
+	{
+		blockingWaitPoint();
+	}
 }
 
 /*****************************************************
  *
  * part of the 'C' command,  does the last little bit to load into the past the extruder gear
+ * *loaded: the filament reached the extruder, the command is acknowledged
  *
  *****************************************************/
-bool filamentLoadWithBondTechGear()
+PT_THREAD(filamentLoadWithBondTechGearThread(struct pt *pt, bool *loaded))
 {
-	int i;
-	int delayFactor; // delay factor (in microseconds) for the filament load loop
-	int stepCount;
-	int tSteps;
+	static int delayFactor; // delay factor (in microseconds) for the filament load loop
+	static int stepCount;
+	static int tSteps;
+	static unsigned long phaseStart;
+#ifdef FILAMENTSWITCH_ON_EXTRUDER
+	static unsigned long waitStart;
+#endif
+
+	PT_BEGIN(pt);
+	*loaded = false;
+	phaseStart = millis();
 
 	// added this code snippet to not process a 'C' command that is essentially a repeat command
 	if (repeatTCmdFlag == ACTIVE)
 	{
-		println_log(F("filamentLoadWithBondTechGear(): filament already loaded and 'C' command already processed"));
+		LOG_INFO("filamentLoadWithBondTechGear(): filament already loaded and 'C' command already processed");
 		repeatTCmdFlag = INACTIVE;
-		return false;
+		PT_EXIT(pt);
 	}
 
 	if (!isFilamentLoadedPinda())
 	{
-		println_log(F("filamentLoadWithBondTechGear()  Error, filament sensor thinks there is no filament"));
-		return false;
+		LOG_ERROR("filamentLoadWithBondTechGear()  Error, filament sensor thinks there is no filament");
+		PT_EXIT(pt);
 	}
 
 	if ((currentExtruder < '0') || (currentExtruder > '4'))
 	{
-		println_log(F("filamentLoadWithBondTechGear(): fixing current extruder variable"));
+		LOG_WARN("filamentLoadWithBondTechGear(): fixing current extruder variable");
 		currentExtruder = '0';
 	}
+	TRACE_EVENT(TRACE_PHASE_BEGIN, STATS_PHASE_C);
 
 	if (idlerStatus == QUICKPARKED)
 	{
@@ -1339,48 +2041,68 @@ bool filamentLoadWithBondTechGear()
 		unParkIdler();
 	}
 
-	stepCount = 0;
 	digitalWrite(greenLED, HIGH); // turn on the green LED (for debug purposes)
 
 	// feed the filament from the MMU2 into the bondtech gear
-	tSteps = STEPSPERMM * ((float)LOAD_DURATION / 1000.0) * LOAD_SPEED;			// compute the number of steps to take for the given load duration
-	delayFactor = (float(LOAD_DURATION * 1000.0) / tSteps) - INSTRUCTION_DELAY; // delayFactor algorithm
+	tSteps = STEPSPERMM * ((float)calibration.loadDuration / 1000.0) * calibration.loadSpeed;			// compute the number of steps to take for the given load duration
+	delayFactor = (float(calibration.loadDuration * 1000.0) / tSteps) - INSTRUCTION_DELAY; // delayFactor algorithm
 
-	digitalWrite(extruderEnablePin, ENABLE); // turn on the extruder stepper motor
+	motorEnable(extruderEnablePin, ENABLE); // turn on the extruder stepper motor
 	digitalWrite(extruderDirPin, CCW);		 // set extruder stepper motor to push filament towards the mk3
 
-	for (i = 0; i < tSteps; i++)
+	for (stepCount = 0; stepCount < tSteps;)
 	{
 		digitalWrite(extruderStepPin, HIGH); // step the extruder stepper in the MMU2 unit
 		delayMicroseconds(PINHIGH);
 		digitalWrite(extruderStepPin, LOW);
 		delayMicroseconds(delayFactor);
 		++stepCount;
+		if ((stepCount % STEPSPERMM) == 0)
+		{
+			PT_YIELD(pt); // the other tasks get their turn every mm
+		}
 	}
 	digitalWrite(greenLED, LOW); // turn off the green LED (for debug purposes)
+	stats_steps(STATS_AXIS_EXTRUDER, stepCount);
 
-#ifdef DEBUG
-	println_log(F("C Command: parking the idler"));
-#endif
+	LOG_DEBUG("C Command: parking the idler");
 
 	parkIdler();
 
 #ifdef FILAMENTSWITCH_ON_EXTRUDER
-	//Wait for MMU code in Marlin to load the filament and activate the filament switch
-	delay(FILAMENT_TO_MK3_C0_WAIT_TIME);
-	if (isFilamentLoadedtoExtruder())
+	// wait for the MMU code in Marlin to load the filament and activate the filament switch,
+	// FILAMENT_TO_MK3_C0_WAIT_TIME at most
+	waitStart = millis();
+	PT_WAIT_UNTIL(pt, isFilamentLoadedtoExtruder() || ((millis() - waitStart) >= FILAMENT_TO_MK3_C0_WAIT_TIME));
+	if (!isFilamentLoadedtoExtruder())
 	{
-		println_log(F("filamentLoadWithBondTechGear(): Loading Filament to Print Head Complete"));
-		return true;
+		LOG_ERROR("filamentLoadWithBondTechGear() : FILAMENT LOAD ERROR:  Filament not detected by EXTRUDER sensor, check the EXTRUDER");
+		stats_failure(STATS_FAIL_C_EXTRUDER);
+		TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_C);
+		PT_EXIT(pt);
 	}
-	println_log(F("filamentLoadWithBondTechGear() : FILAMENT LOAD ERROR:  Filament not detected by EXTRUDER sensor, check the EXTRUDER"));
-	return false;
+	LOG_INFO("filamentLoadWithBondTechGear(): Loading Filament to Print Head Complete");
+#else
+	LOG_DEBUG("filamentLoadWithBondTechGear(): Loading Filament to Print Head Complete");
 #endif
 
-#ifdef DEBUG
-	println_log(F("filamentLoadWithBondTechGear(): Loading Filament to Print Head Complete"));
-#endif
-	return true;
+	TRACE_EVENT(TRACE_PHASE_END, STATS_PHASE_C);
+	stats_phase(STATS_PHASE_C, millis() - phaseStart);
+	*loaded = true;
+	PT_END(pt);
+}
+
+bool filamentLoadWithBondTechGear()
+{
+	struct pt pt;
+	bool loaded;
+
+	PT_INIT(&pt);
+	while (PT_SCHEDULE(filamentLoadWithBondTechGearThread(&pt, &loaded)))
+	{
+		blockingWaitPoint();
+	}
+	return loaded;
 }
 
 /************************************************************************************************************/
@@ -2,32 +2,79 @@
 #define APPLICATION_H
 
 #include <Arduino.h>
+#include "fixedstring.h"
+#include "pt.h"
+
+// longest command line accepted from the printer or the debug console
+#define COMMAND_LINE_SIZE 32
+// longest error message reported by fixTheProblem()
+#define ERROR_MESSAGE_SIZE 127
+
+typedef FixedString<COMMAND_LINE_SIZE> CommandLine;
+typedef FixedString<ERROR_MESSAGE_SIZE> ErrorMessage;
+
+extern int filamentSelection;
+extern int idlerStatus;
+extern char motionCommand;
+extern bool problemPending;
 
 extern int isFilamentLoadedPinda();
 extern bool isFilamentLoadedtoExtruder();
 
 extern void initIdlerPosition();
-extern void checkSerialInterface();
-extern String ReadSerialStrUntilNewLine();
+extern void processPrinterCommand(const CommandLine &inputLine);
+extern void processConsoleCommand(const CommandLine &kbString);
+extern void ReadSerialStrUntilNewLine(CommandLine &str);
+extern bool serial1Ready();
+extern void serial1Receive();
+extern bool dispatchReady();
+extern void dispatchCommand();
+extern void startMotion(char cmd, char arg);
+extern bool motionReady();
+extern char motionThread(struct pt *pt);
+extern void motionStep();
+extern bool consoleReady();
+extern void consoleReceive();
+extern void monitorSensors();
+extern void displayRefresh();
+extern void maintenance();
+extern void ackCommand(char cmd);
 extern void initColorSelector();
 extern void filamentLoadToMK3();
+extern char filamentLoadToMK3Thread(struct pt *pt);
 extern bool filamentLoadWithBondTechGear();
+extern char filamentLoadWithBondTechGearThread(struct pt *pt, bool *loaded);
 extern void toolChange( char selection);
+extern char toolChangeThread(struct pt *pt, char selection);
 extern void quickParkIdler();
 extern void quickUnParkIdler();
 extern void unParkIdler();
 extern void unloadFilamentToFinda();
+extern char unloadFilamentToFindaThread(struct pt *pt);
 extern void parkIdler();
 extern void activateColorSelector();
 extern void deActivateColorSelector();
+extern void motorEnable(uint8_t enablePin, uint8_t state); // ENABLE / DISABLE
+extern int sensorRead(uint8_t pin); // findaPin, filamentSwitch, colorSelectorEnstop
+extern int printerAvailable();
+extern int consoleAvailable();
+extern int consoleRead();
 extern void idlerSelector(char filament);
 extern void colorSelector(char selection);
+extern char colorSelectorThread(struct pt *pt, char selection);
 extern void loadFilamentToFinda();
-extern void fixTheProblem(String statement);
+extern char loadFilamentToFindaThread(struct pt *pt);
+extern void fixTheProblem(const __FlashStringHelper *statement, uint8_t failure); // failure: STATS_FAIL_xxx
+extern char fixTheProblemThread(struct pt *pt, const __FlashStringHelper *statement, uint8_t failure);
 extern void csTurnAmount(int steps, int direction);
 extern void feedFilament(unsigned int steps, int stoptoextruder);
 extern void idlerturnamount(int steps, int dir);
 extern void syncColorSelector();
+extern void applyCalibration();
+extern void recordMechanicalState();
+extern bool warmBoot();
+extern bool recoverToolChange();
+extern void processCalibrationCommand(const char *args);
 
 class Application
 {
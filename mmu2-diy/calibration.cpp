@@ -0,0 +1,177 @@
+#include "calibration.h"
+#include "storage.h"
+#include "config.h"
+#include "print.h"
+
+#include <stddef.h>
+
+Calibration calibration;
+
+/*************************/
+// Limits of the values, from the geometry in config.h
+//
+// A slot offset stays under half the pitch (two slots never swap) and keeps the
+// position within the travel; the idler also quick parks IDLERSTEPSIZE further
+// than its slot. The lengths and the 'C' load go at most twice their default:
+// 2 * LOAD_DURATION ms at 2 * LOAD_SPEED mm/s is 17280 steps, within the int of
+// filamentLoadWithBondTechGear() on AVR, 90 us between two of them.
+/*************************/
+struct CalibrationLimit
+{
+	uint8_t offset; // of the int16_t / uint16_t field in Calibration
+	int16_t min;
+	int16_t max;
+};
+
+#define SLOT_MIN(pitch, i) ((-(pitch) * (i) > -((pitch)-1) / 2) ? -(pitch) * (i) : -((pitch)-1) / 2)
+#define SLOT_MAX(pitch, travel, i) (((travel) - (pitch) * (i) < ((pitch)-1) / 2) ? (travel) - (pitch) * (i) : ((pitch)-1) / 2)
+#define CS_LIMIT(i) {offsetof(Calibration, csOffset) + (i) * sizeof(int16_t), SLOT_MIN(CSSTEPS, i), SLOT_MAX(CSSTEPS, MAXSELECTOR_STEPS, i)}
+#define IDLER_LIMIT(i) {offsetof(Calibration, idlerOffset) + (i) * sizeof(int16_t), SLOT_MIN(IDLERSTEPSIZE, i), SLOT_MAX(IDLERSTEPSIZE, MAXROLLERTRAVEL - IDLERSTEPSIZE, i)}
+
+// in the order of the names of calibration_set()
+enum
+{
+	CAL_CS0 = 0,
+	CAL_IDLER0 = 5,
+	CAL_DIST = 10,
+	CAL_BACK,
+	CAL_IDLERDELAY,
+	CAL_EXTDELAY,
+	CAL_CSDELAY,
+	CAL_LOADMS,
+	CAL_LOADSPEED,
+	CAL_FIELDS
+};
+
+static const CalibrationLimit limits[CAL_FIELDS] = {
+	CS_LIMIT(0), CS_LIMIT(1), CS_LIMIT(2), CS_LIMIT(3), CS_LIMIT(4),
+	IDLER_LIMIT(0), IDLER_LIMIT(1), IDLER_LIMIT(2), IDLER_LIMIT(3), IDLER_LIMIT(4),
+	{offsetof(Calibration, distMmuExtruder), FEED_YIELD_MM, 2 * DIST_MMU_EXTRUDER},
+	{offsetof(Calibration, unloadLengthBack), 1, 2 * UNLOAD_LENGTH_BACK_COLORSELECTOR},
+	{offsetof(Calibration, idlerMotorDelay), 100, 2000},		 // us, from a stall to a crawl
+	{offsetof(Calibration, extruderMotorDelay), 20, 1000},		 // us
+	{offsetof(Calibration, colorSelectorMotorDelay), 20, 1000}, // us
+	{offsetof(Calibration, loadDuration), 100, 2 * LOAD_DURATION},
+	{offsetof(Calibration, loadSpeed), 1, 2 * LOAD_SPEED},
+};
+
+static int16_t *calibration_field(Calibration *record, uint8_t field)
+{
+	// all the fields are 16 bit and the limits fit an int16_t: an unsigned
+	// value past 32767 reads as negative, below its limit
+	return (int16_t *)((uint8_t *)record + limits[field].offset);
+}
+
+static bool calibration_in_range(uint8_t field, long value)
+{
+	return (value >= limits[field].min) && (value <= limits[field].max);
+}
+
+// -1 for an unknown name
+static int8_t calibration_index(const char *name)
+{
+	if ((strncmp(name, "cs", 2) == 0) && (name[2] >= '0') && (name[2] <= '4') && !name[3])
+		return CAL_CS0 + name[2] - '0';
+	if ((strncmp(name, "idler", 5) == 0) && (name[5] >= '0') && (name[5] <= '4') && !name[6])
+		return CAL_IDLER0 + name[5] - '0';
+	if (strcmp(name, "dist") == 0)
+		return CAL_DIST;
+	if (strcmp(name, "back") == 0)
+		return CAL_BACK;
+	if (strcmp(name, "idlerdelay") == 0)
+		return CAL_IDLERDELAY;
+	if (strcmp(name, "extdelay") == 0)
+		return CAL_EXTDELAY;
+	if (strcmp(name, "csdelay") == 0)
+		return CAL_CSDELAY;
+	if (strcmp(name, "loadms") == 0)
+		return CAL_LOADMS;
+	if (strcmp(name, "loadspeed") == 0)
+		return CAL_LOADSPEED;
+	return -1;
+}
+
+void calibration_defaults()
+{
+	calibration.version = CALIBRATION_VERSION;
+	for (uint8_t i = 0; i < 5; i++)
+	{
+		calibration.csOffset[i] = CSOFFSET[i];
+		calibration.idlerOffset[i] = IDLEROFFSET[i];
+	}
+	calibration.distMmuExtruder = DIST_MMU_EXTRUDER;
+	calibration.unloadLengthBack = UNLOAD_LENGTH_BACK_COLORSELECTOR;
+	calibration.idlerMotorDelay = IDLERMOTORDELAY;
+	calibration.extruderMotorDelay = EXTRUDERMOTORDELAY;
+	calibration.colorSelectorMotorDelay = COLORSELECTORMOTORDELAY;
+	calibration.loadDuration = LOAD_DURATION;
+	calibration.loadSpeed = LOAD_SPEED;
+}
+
+bool calibration_load()
+{
+	Calibration stored;
+
+	calibration_defaults();
+	if (!storage_load(STORAGE_KEY_CALIBRATION, &stored, sizeof(stored)))
+	{
+		LOG_INFO("calibration: no stored record, using the defaults");
+		return false;
+	}
+	if (stored.version != CALIBRATION_VERSION)
+	{
+		LOG_WARN("calibration: record version %d, expected %d, using the defaults", (int)stored.version, CALIBRATION_VERSION);
+		return false;
+	}
+	// the crc only says the record is the one written: it may come from a build
+	// with other limits, nothing out of range reaches the position tables
+	for (uint8_t i = 0; i < CAL_FIELDS; i++)
+	{
+		int16_t value = *calibration_field(&stored, i);
+
+		if (!calibration_in_range(i, value))
+		{
+			LOG_WARN("calibration: stored value %d of field %d out of range, using the defaults", (int)value, (int)i);
+			return false;
+		}
+	}
+	calibration = stored;
+	LOG_INFO("calibration: loaded");
+	return true;
+}
+
+bool calibration_commit()
+{
+	calibration.version = CALIBRATION_VERSION;
+	switch (storage_save(STORAGE_KEY_CALIBRATION, &calibration, sizeof(calibration)))
+	{
+	case STORAGE_SAVED:
+		LOG_INFO("calibration: saved");
+		return true;
+	case STORAGE_QUEUED:
+		LOG_INFO("calibration: queued, stored at the next idle point");
+		return true;
+	default:
+		LOG_ERROR("calibration: write failed");
+		return false;
+	}
+}
+
+bool calibration_set(const char *name, long value)
+{
+	int8_t field = calibration_index(name);
+
+	if ((field < 0) || !calibration_in_range(field, value))
+		return false;
+	*calibration_field(&calibration, field) = value;
+	return true;
+}
+
+void calibration_report()
+{
+	LOG_INFO("cs0..4: %d %d %d %d %d", calibration.csOffset[0], calibration.csOffset[1], calibration.csOffset[2], calibration.csOffset[3], calibration.csOffset[4]);
+	LOG_INFO("idler0..4: %d %d %d %d %d", calibration.idlerOffset[0], calibration.idlerOffset[1], calibration.idlerOffset[2], calibration.idlerOffset[3], calibration.idlerOffset[4]);
+	LOG_INFO("dist: %d back: %d", calibration.distMmuExtruder, calibration.unloadLengthBack);
+	LOG_INFO("idlerdelay: %u extdelay: %u csdelay: %u", calibration.idlerMotorDelay, calibration.extruderMotorDelay, calibration.colorSelectorMotorDelay);
+	LOG_INFO("loadms: %u loadspeed: %u", calibration.loadDuration, calibration.loadSpeed);
+}
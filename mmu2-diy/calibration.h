@@ -0,0 +1,47 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+
+/*************************/
+// Calibration record
+//
+// The compile-time values of config.h are the defaults. The record is stored with
+// storage_save() (crc protected, atomic) and loaded at boot; a missing record, a
+// bad crc, an older CALIBRATION_VERSION or a value out of its limits fall back
+// to the defaults.
+/*************************/
+
+// bump when the layout of Calibration changes
+#define CALIBRATION_VERSION 1
+
+struct Calibration
+{
+	uint8_t version;
+	int16_t csOffset[5];			 // CSOFFSET
+	int16_t idlerOffset[5];			 // IDLEROFFSET
+	int16_t distMmuExtruder;		 // DIST_MMU_EXTRUDER (mm)
+	int16_t unloadLengthBack;		 // UNLOAD_LENGTH_BACK_COLORSELECTOR (mm)
+	uint16_t idlerMotorDelay;		 // IDLERMOTORDELAY (us)
+	uint16_t extruderMotorDelay;	 // EXTRUDERMOTORDELAY (us)
+	uint16_t colorSelectorMotorDelay; // COLORSELECTORMOTORDELAY (us)
+	uint16_t loadDuration;			 // LOAD_DURATION (ms)
+	uint16_t loadSpeed;				 // LOAD_SPEED (mm/s)
+};
+
+extern Calibration calibration;
+
+void calibration_defaults();
+
+// returns false (and keeps the defaults) if there is no valid record
+bool calibration_load();
+
+bool calibration_commit();
+
+// set one field by name (cs0..cs4, idler0..idler4, dist, back, idlerdelay, extdelay, csdelay, loadms, loadspeed),
+// false for an unknown name or a value out of the limits of calibration.cpp
+bool calibration_set(const char *name, long value);
+
+void calibration_report();
+
+#endif // CALIBRATION_H
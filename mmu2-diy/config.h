@@ -2,8 +2,10 @@
 #define CONFIG_H
 
 
-//#define DEBUG
-#define DEBUGMODE
+// log verbosity: see LOG_LEVEL in print.h
+#define DEBUGMODE                 // extra debug console commands (D, Z, A)
+//#define EVENT_TRACE             // event trace ring buffer, E console command (see trace.h)
+//#define FIELD_RECORDER          // inputs and printer traffic on the console, for mmu-replay (see recorder.h)
 
 
 #define SERIAL1ENABLED    1
@@ -15,6 +17,14 @@
 #define STEPSPERMM  144ul           // these are the number of steps required to travel 1 mm using the extruder motor
 
 #define S1_WAIT_TIME 10  //wait time for serial 1 (mmu<->printer)
+#define START_RESEND_INTERVAL 2000  // ms between two "start" messages while the printer has not answered
+#define SERIAL1_LINE_TIMEOUT 20  // give up on a partial command line after this many ms without a new byte
+
+// periods of the background tasks (ms), see the task table in application.cpp
+#define SENSOR_PERIOD 50
+#define DISPLAY_PERIOD 20
+#define MAINTENANCE_PERIOD 1000
+#define FEED_YIELD_MM 10 // the bowden feed lets the other tasks run every FEED_YIELD_MM mm
 
 #define FW_VERSION 90             // config.h  (MM-control-01 firmware)
 #define FW_BUILDNR 168             // config.h  (MM-control-01 firmware)
@@ -70,7 +80,7 @@
 // Distance to restract the filament into the MMU 
 #define UNLOAD_LENGTH_BACK_COLORSELECTOR 30
 //
-int IDLEROFFSET[5] = {0,0,0,0,0};
+const int IDLEROFFSET[5] = {0,0,0,0,0};   // default, see calibration.h
 #define IDLERSTEPSIZE 25         // steps to each roller bearing
 
 
@@ -78,13 +88,15 @@ int IDLEROFFSET[5] = {0,0,0,0,0};
 // changed position #2 to 372  (still tuning this little sucker)
 
 #define MAXSELECTOR_STEPS   1800//1890   // maximum number of selector stepper motor (used to move all the way to the right or left
-int CSOFFSET[5] = {30,30,0,-15,-30};
+const int CSOFFSET[5] = {30,30,0,-15,-30}; // default, see calibration.h
 #define CSSTEPS 357
 #define CS_RIGHT_FORCE 20
 #define CS_RIGHT_FORCE_SELECTOR_0 5
 
 //*************************************************************************************************
 //  Delay values for each stepper motor
+//  (defaults: the offsets, distances, delays and load speed above can be changed at run time
+//   and stored in EEPROM with the 'K' debug console command, see calibration.h)
 //*************************************************************************************************
 #define IDLERMOTORDELAY  540     //540 useconds      (idler motor)  was at '500' on 10.13.18
 #define EXTRUDERMOTORDELAY 60//50     // 150 useconds    (controls filament feed speed to the printer)
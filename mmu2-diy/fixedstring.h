@@ -0,0 +1,71 @@
+#ifndef FIXEDSTRING_H
+#define FIXEDSTRING_H
+
+#include <Arduino.h>
+
+/*************************/
+// Fixed-capacity string, replaces the Arduino String on the command and error paths.
+//
+// The storage is part of the object (stack or static), nothing is ever allocated.
+// Characters appended past the capacity are dropped and the string is flagged
+// as truncated. Reading past the end returns 0, like String::operator[].
+/*************************/
+template <uint8_t CAPACITY>
+class FixedString
+{
+public:
+	FixedString()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		len = 0;
+		overflow = false;
+		buffer[0] = 0;
+	}
+
+	bool append(char c)
+	{
+		if (len >= CAPACITY)
+		{
+			overflow = true;
+			return false;
+		}
+		buffer[len++] = c;
+		buffer[len] = 0;
+		return true;
+	}
+
+	// copy a string kept in flash (F() / PSTR())
+	void assign(const __FlashStringHelper *str)
+	{
+		const char *p = (const char *)str;
+		char c;
+
+		clear();
+		while ((c = pgm_read_byte(p++)) != 0)
+		{
+			if (!append(c))
+				break;
+		}
+	}
+
+	char operator[](uint8_t index) const
+	{
+		return (index < len) ? buffer[index] : 0;
+	}
+
+	const char *c_str() const { return buffer; }
+	uint8_t length() const { return len; }
+	uint8_t capacity() const { return CAPACITY; }
+	bool truncated() const { return overflow; }
+
+private:
+	char buffer[CAPACITY + 1];
+	uint8_t len;
+	bool overflow;
+};
+
+#endif // FIXEDSTRING_H
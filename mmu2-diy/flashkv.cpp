@@ -0,0 +1,198 @@
+#include "flashkv.h"
+
+#ifdef __STM32F1__
+#include <flash_stm32.h>
+#include "storage.h"
+
+#define FLASHKV_HALFWORDS (FLASHKV_PAGE_SIZE / 2)
+#define FLASHKV_FIRST_RECORD 2 // after magic and generation
+#define FLASHKV_BLANK 0xFFFF
+
+extern "C" uint8_t __kvstore_start;
+
+static int8_t activePage = -1; // -1: not initialised yet
+static uint16_t writeOffset;	  // first free half word of the active page
+static bool compactRequested = false;
+
+static volatile uint16_t *flashkv_page(uint8_t page)
+{
+	return (volatile uint16_t *)(&__kvstore_start + page * FLASHKV_PAGE_SIZE);
+}
+
+static bool flashkv_program(volatile uint16_t *address, uint16_t value)
+{
+	return FLASH_ProgramHalfWord((uint32)(uintptr_t)address, value) == FLASH_COMPLETE;
+}
+
+static bool flashkv_erase(uint8_t page)
+{
+	return FLASH_ErasePage((uint32)(uintptr_t)flashkv_page(page)) == FLASH_COMPLETE;
+}
+
+static uint16_t flashkv_record_length(uint16_t header)
+{
+	// header + data + crc, in half words
+	return 1 + (((header >> 8) + 1) / 2) + 1;
+}
+
+static bool flashkv_record_valid(volatile uint16_t *record)
+{
+	uint8_t size = record[0] >> 8;
+	uint8_t key = record[0] & 0xFF;
+	uint16_t crc = storage_crc16(&key, 1);
+
+	crc = storage_crc16((const uint8_t *)&record[1], size, crc);
+	return record[1 + (size + 1) / 2] == crc;
+}
+
+// finds the end of the log of the active page
+static void flashkv_scan()
+{
+	volatile uint16_t *page = flashkv_page(activePage);
+	uint16_t offset = FLASHKV_FIRST_RECORD;
+
+	while ((offset < FLASHKV_HALFWORDS) && (page[offset] != FLASHKV_BLANK))
+		offset += flashkv_record_length(page[offset]);
+	writeOffset = offset;
+	if (writeOffset > FLASHKV_HALFWORDS * 3 / 4)
+		compactRequested = true;
+}
+
+static void flashkv_init()
+{
+	bool valid0 = flashkv_page(0)[0] == FLASHKV_MAGIC;
+	bool valid1 = flashkv_page(1)[0] == FLASHKV_MAGIC;
+
+	if (valid0 && valid1)
+	{
+		// a compaction was cut short after its commit: the newer generation wins
+		activePage = ((int16_t)(flashkv_page(1)[1] - flashkv_page(0)[1]) > 0) ? 1 : 0;
+	}
+	else if (valid0 || valid1)
+	{
+		activePage = valid0 ? 0 : 1;
+	}
+	else
+	{
+		// first boot: format page 0 (only happens once, from setup())
+		FLASH_Unlock();
+		flashkv_erase(0);
+		flashkv_program(&flashkv_page(0)[1], 1);
+		flashkv_program(&flashkv_page(0)[0], FLASHKV_MAGIC);
+		FLASH_Lock();
+		activePage = 0;
+	}
+	flashkv_scan();
+}
+
+// offset of the newest valid record of a key in a page, 0 if none
+static uint16_t flashkv_find(uint8_t page, uint8_t key)
+{
+	volatile uint16_t *base = flashkv_page(page);
+	uint16_t offset = FLASHKV_FIRST_RECORD;
+	uint16_t found = 0;
+
+	while ((offset < FLASHKV_HALFWORDS) && (base[offset] != FLASHKV_BLANK))
+	{
+		if (((base[offset] & 0xFF) == key) && flashkv_record_valid(&base[offset]))
+			found = offset;
+		offset += flashkv_record_length(base[offset]);
+	}
+	return found;
+}
+
+bool flashkv_get(uint8_t key, void *data, uint8_t size)
+{
+	volatile uint16_t *record;
+	uint16_t offset;
+
+	if (activePage < 0)
+		flashkv_init();
+	offset = flashkv_find(activePage, key);
+	if (!offset)
+		return false;
+	record = &flashkv_page(activePage)[offset];
+	if ((record[0] >> 8) != size)
+		return false;
+	memcpy(data, (const void *)&record[1], size);
+	return true;
+}
+
+static bool flashkv_append(uint8_t page, uint16_t *offset, uint8_t key, const uint8_t *data, uint8_t size)
+{
+	volatile uint16_t *base = flashkv_page(page);
+	uint16_t header = key | (size << 8);
+	uint16_t crc = storage_crc16(&key, 1);
+	uint16_t at = *offset;
+	bool ok;
+
+	if (at + flashkv_record_length(header) > FLASHKV_HALFWORDS)
+		return false;
+	crc = storage_crc16(data, size, crc);
+
+	// header first: even if the rest is cut short, the next record starts after it
+	ok = flashkv_program(&base[at++], header);
+	for (uint8_t i = 0; i < size; i += 2)
+		ok = flashkv_program(&base[at++], data[i] | ((i + 1 < size) ? data[i + 1] << 8 : 0xFF00)) && ok;
+	ok = flashkv_program(&base[at++], crc) && ok;
+	*offset = at;
+	return ok;
+}
+
+bool flashkv_put(uint8_t key, const void *data, uint8_t size)
+{
+	bool ok;
+
+	if (activePage < 0)
+		flashkv_init();
+	FLASH_Unlock();
+	ok = flashkv_append(activePage, &writeOffset, key, (const uint8_t *)data, size);
+	FLASH_Lock();
+	if (!ok || (writeOffset > FLASHKV_HALFWORDS * 3 / 4))
+		compactRequested = true;
+	return ok;
+}
+
+bool flashkv_compaction_pending()
+{
+	return compactRequested;
+}
+
+void flashkv_idle()
+{
+	uint8_t target;
+	uint16_t offset, found;
+	volatile uint16_t *record;
+
+	if (!compactRequested)
+		return;
+	if (activePage < 0)
+		flashkv_init();
+	target = 1 - activePage;
+
+	FLASH_Unlock();
+	if (!flashkv_erase(target))
+	{
+		FLASH_Lock();
+		return; // try again at the next idle point
+	}
+	offset = FLASHKV_FIRST_RECORD;
+	for (uint16_t key = 0; key < 0xFF; key++)
+	{
+		found = flashkv_find(activePage, key);
+		if (!found)
+			continue;
+		record = &flashkv_page(activePage)[found];
+		flashkv_append(target, &offset, key, (const uint8_t *)&record[1], record[0] >> 8);
+	}
+	// commit: generation, then magic
+	flashkv_program(&flashkv_page(target)[1], flashkv_page(activePage)[1] + 1);
+	flashkv_program(&flashkv_page(target)[0], FLASHKV_MAGIC);
+	flashkv_erase(activePage);
+	FLASH_Lock();
+
+	activePage = target;
+	compactRequested = false;
+	flashkv_scan();
+}
+#endif
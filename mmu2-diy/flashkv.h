@@ -0,0 +1,32 @@
+#ifndef FLASHKV_H
+#define FLASHKV_H
+
+#include <Arduino.h>
+
+/*************************/
+// Log-structured key/value store in two flash pages (SKR mini / STM32F103)
+//
+// The pages are reserved by buildroot/share/PlatformIO/ldscripts/STM32F103RC_SKR_MINI.ld
+// (__kvstore_start). Only one page is active at a time:
+//   page   : magic | generation | record | record | ... | 0xFFFF (free)
+//   record : key | size (one half word) | data (padded to a half word) | crc16
+// flashkv_put() appends a record (a few half word programs, no erase); the last
+// record of a key wins. When the page is full, or 3/4 full, a compaction is
+// requested: flashkv_idle() copies the newest record of every key to the other
+// page, writes its header last (that is the commit) and erases the old page.
+// Erases only ever happen there, so call flashkv_idle() only when the MMU is idle.
+/*************************/
+
+#define FLASHKV_PAGE_SIZE 2048 // STM32F103 high density
+#define FLASHKV_MAGIC 0x4B56
+
+bool flashkv_get(uint8_t key, void *data, uint8_t size);
+
+// false if the active page is full: retry after flashkv_idle()
+bool flashkv_put(uint8_t key, const void *data, uint8_t size);
+
+bool flashkv_compaction_pending();
+
+void flashkv_idle();
+
+#endif // FLASHKV_H
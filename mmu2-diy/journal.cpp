@@ -0,0 +1,25 @@
+#include "journal.h"
+#include "storage.h"
+#include "print.h"
+
+bool journal_load(Journal *journal)
+{
+	if (!storage_load(STORAGE_KEY_JOURNAL, journal, sizeof(Journal)) || (journal->phase > JOURNAL_FEED) ||
+		(journal->from > 4) || (journal->to > 4))
+	{
+		memset(journal, 0, sizeof(Journal));
+		return false;
+	}
+	return true;
+}
+
+void journal_write(uint8_t phase, uint8_t from, uint8_t to)
+{
+	Journal journal;
+
+	journal.phase = phase;
+	journal.from = from;
+	journal.to = to;
+	if (storage_save(STORAGE_KEY_JOURNAL, &journal, sizeof(journal)) != STORAGE_SAVED)
+		LOG_WARN("journal: phase %d not stored, a reset now recovers from the previous one", (int)phase);
+}
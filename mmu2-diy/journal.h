@@ -0,0 +1,32 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+
+/*************************/
+// Tool change journal
+//
+// toolChange() stores the phase it is entering (write-ahead, one record per
+// phase boundary, nothing while the motors run) and JOURNAL_NONE once the swap
+// is done. A journal that is not JOURNAL_NONE at boot means the swap was cut
+// short: see recoverToolChange() in application.cpp.
+/*************************/
+
+#define JOURNAL_NONE 0	 // no tool change in progress
+#define JOURNAL_UNLOAD 1 // unloading slot `from` back to the MMU
+#define JOURNAL_SELECT 2 // old filament out of the selector, idler and selector moving to `to`
+#define JOURNAL_FEED 3	 // feeding slot `to` through the bowden to the extruder
+
+struct Journal
+{
+	uint8_t phase;
+	uint8_t from; // slot loaded before the swap
+	uint8_t to;	  // slot requested
+};
+
+// returns false if there is no valid journal (a missing journal reads as JOURNAL_NONE)
+bool journal_load(Journal *journal);
+
+void journal_write(uint8_t phase, uint8_t from, uint8_t to);
+
+#endif // JOURNAL_H
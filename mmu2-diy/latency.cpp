@@ -0,0 +1,73 @@
+#include "latency.h"
+#include "print.h"
+
+/*************************/
+// one slot per known command, the last one collects unknown commands
+static const char LATENCY_COMMANDS[] = "TCULSPF?";
+#define LATENCY_SLOTS (sizeof(LATENCY_COMMANDS) - 1)
+
+struct LatencyStat
+{
+    unsigned long count;
+    unsigned long minUs;
+    unsigned long maxUs;
+    uint64_t sumUs; // 64 bits so that long tool changes can't overflow it
+};
+
+static LatencyStat latencyStats[LATENCY_SLOTS];
+static unsigned long latencyStart = 0;
+static char latencyPending = 0;
+
+static uint8_t latency_slot(char cmd)
+{
+    for (uint8_t i = 0; i < LATENCY_SLOTS - 1; i++)
+    {
+        if (LATENCY_COMMANDS[i] == cmd)
+            return i;
+    }
+    return LATENCY_SLOTS - 1;
+}
+
+void latency_begin(char cmd)
+{
+    latencyStart = micros();
+    latencyPending = cmd;
+}
+
+void latency_ack(char cmd)
+{
+    unsigned long elapsed;
+    LatencyStat *stat;
+
+    if (latencyPending != cmd)
+        return; // ack without a matching receive (should not happen)
+    elapsed = micros() - latencyStart;
+    latencyPending = 0;
+
+    stat = &latencyStats[latency_slot(cmd)];
+    if ((stat->count == 0) || (elapsed < stat->minUs))
+        stat->minUs = elapsed;
+    if (elapsed > stat->maxUs)
+        stat->maxUs = elapsed;
+    stat->sumUs += elapsed;
+    stat->count++;
+}
+
+void latency_reset()
+{
+    memset(latencyStats, 0, sizeof(latencyStats));
+    latencyPending = 0;
+}
+
+void latency_report()
+{
+    LOG_INFO("CMD | COUNT | MIN (us) | AVG (us) | MAX (us)");
+    for (uint8_t i = 0; i < LATENCY_SLOTS; i++)
+    {
+        LatencyStat *stat = &latencyStats[i];
+        if (stat->count == 0)
+            continue;
+        LOG_INFO("%c   | %lu | %lu | %lu | %lu", LATENCY_COMMANDS[i], stat->count, stat->minUs, (unsigned long)(stat->sumUs / stat->count), stat->maxUs);
+        log_flush();
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+
+/*************************/
+// Receive-to-ack latency of the commands coming from the printer board.
+//
+// latency_begin() is called when the first byte of a command is seen on Serial1,
+// latency_ack() right after the "ok" has been queued. Min / avg / max are kept
+// per command type (T, C, U, L, S, P, F and everything else) in microseconds.
+/*************************/
+
+void latency_begin(char cmd);
+
+void latency_ack(char cmd);
+
+void latency_reset();
+
+void latency_report();
+
+#endif // LATENCY_H
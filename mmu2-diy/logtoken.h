@@ -0,0 +1,117 @@
+#ifndef LOGTOKEN_H
+#define LOGTOKEN_H
+
+#include <Arduino.h>
+
+/*************************/
+// Tokenized log encoding (build with -DLOG_TOKENIZED)
+//
+// Instead of the format string, each LOG_xxx() call sends the 32 bit FNV-1a hash
+// of its format string followed by the arguments in binary form. The hash is
+// computed by the compiler, so the format string itself never reaches the flash.
+//
+// Frame on the debug serial port:
+//   0xFE | length | token (4 bytes, little endian) | arguments
+// Arguments, in the order of the format string:
+//   %d %i        zigzag varint
+//   %u %x %X     varint
+//   %c           one byte
+//   %s           length byte + characters (truncated to LOG_TOKEN_MAX_STRING)
+//
+// buildroot/share/scripts/mmu_log_tokens.py builds the token dictionary from the
+// sources and decodes the frames back to text.
+/*************************/
+
+#define LOG_TOKEN_FRAME_START 0xFE
+#define LOG_TOKEN_FRAME_SIZE 64
+#define LOG_TOKEN_MAX_STRING 24
+
+constexpr uint32_t log_token_hash(const char *s, uint32_t hash = 2166136261ul)
+{
+	return *s ? log_token_hash(s + 1, (hash ^ (uint8_t)*s) * 16777619ul) : hash;
+}
+
+// forces the hash to be evaluated at compile time
+template <uint32_t TOKEN>
+struct LogToken
+{
+	static const uint32_t value = TOKEN;
+};
+
+#define LOG_TOKEN(fmt) (LogToken<log_token_hash(fmt)>::value)
+
+// queue an encoded frame (start byte and length are added here)
+void log_frame(const uint8_t *frame, uint8_t length);
+
+inline uint8_t *log_arg_varint(uint8_t *p, uint8_t *end, uint32_t value)
+{
+	while ((value >= 0x80) && (p < end - 1))
+	{
+		*p++ = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+inline uint8_t *log_arg_zigzag(uint8_t *p, uint8_t *end, int32_t value)
+{
+	return log_arg_varint(p, end, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, char value)
+{
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, signed char value) { return log_arg_zigzag(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, short value) { return log_arg_zigzag(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, int value) { return log_arg_zigzag(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, long value) { return log_arg_zigzag(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, unsigned char value) { return log_arg_varint(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, unsigned short value) { return log_arg_varint(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, unsigned int value) { return log_arg_varint(p, end, value); }
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, unsigned long value) { return log_arg_varint(p, end, value); }
+
+inline uint8_t *log_arg(uint8_t *p, uint8_t *end, const char *value)
+{
+	uint8_t length = 0;
+	uint8_t *start = p++;
+
+	while (value[length] && (length < LOG_TOKEN_MAX_STRING) && (p < end))
+		*p++ = value[length++];
+	*start = length;
+	return p;
+}
+
+inline uint8_t *log_args(uint8_t *p, uint8_t *end)
+{
+	return p;
+}
+
+template <typename T, typename... Rest>
+inline uint8_t *log_args(uint8_t *p, uint8_t *end, T first, Rest... rest)
+{
+	// keep room for the largest argument (a string)
+	if (p > end - (LOG_TOKEN_MAX_STRING + 1))
+		return p;
+	p = log_arg(p, end, first);
+	return log_args(p, end, rest...);
+}
+
+template <typename... Args>
+void log_tokenized(uint32_t token, Args... args)
+{
+	uint8_t frame[LOG_TOKEN_FRAME_SIZE];
+	uint8_t *p = frame;
+
+	*p++ = token;
+	*p++ = token >> 8;
+	*p++ = token >> 16;
+	*p++ = token >> 24;
+	p = log_args(p, frame + sizeof(frame), args...);
+	log_frame(frame, p - frame);
+}
+
+#endif // LOGTOKEN_H
@@ -0,0 +1,50 @@
+#include "mechstate.h"
+#include "storage.h"
+#include "print.h"
+
+MechState mechState;
+
+bool mechstate_load()
+{
+	if (!storage_load(STORAGE_KEY_MECHANICAL, &mechState, sizeof(mechState)) || (mechState.version != MECHSTATE_VERSION))
+	{
+		memset(&mechState, 0, sizeof(mechState));
+		return false;
+	}
+	return true;
+}
+
+void mechstate_motion_begin()
+{
+	// one write per run of commands: the record only needs to say "moving" once
+	if (!mechState.clean)
+		return;
+	mechState.version = MECHSTATE_VERSION;
+	mechState.clean = 0;
+	// no flash compaction here, maintenance() runs it between two commands: the
+	// record is queued only if the page filled up before maintenance() got to
+	// the compaction asked for at 3/4 of it
+	switch (storage_save(STORAGE_KEY_MECHANICAL, &mechState, sizeof(mechState)))
+	{
+	case STORAGE_SAVED:
+		break;
+	case STORAGE_QUEUED:
+		LOG_WARN("mechstate: store full, a reset before the next idle point is taken for a clean state");
+		break;
+	default:
+		LOG_WARN("mechstate: write failed, a reset now is taken for a clean state");
+		break;
+	}
+}
+
+void mechstate_motion_end()
+{
+	mechState.version = MECHSTATE_VERSION;
+	mechState.clean = 1;
+	// queued is fine: until it is written the stored record says "moving"
+	if (storage_save(STORAGE_KEY_MECHANICAL, &mechState, sizeof(mechState)) == STORAGE_FAILED)
+	{
+		LOG_WARN("mechstate: write failed");
+		mechState.clean = 0; // do not trust a record that is not there
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef MECHSTATE_H
+#define MECHSTATE_H
+
+#include <Arduino.h>
+
+/*************************/
+// Mechanical state kept across resets, for the warm boot
+//
+// mechstate_motion_begin() stores the record as "moving" before the first step
+// of a command, mechstate_motion_end() stores the positions as "clean" once the
+// command is done. A reset in between leaves the "moving" record: the next boot
+// homes the axes. After a clean record the boot can skip the homing sweeps
+// (see warmBoot() in application.cpp).
+/*************************/
+
+// bump when the layout of MechState changes
+#define MECHSTATE_VERSION 1
+
+struct MechState
+{
+	uint8_t version;
+	uint8_t clean;			   // 1: no motion since the positions were stored
+	uint8_t filamentSelection; // 0..4
+	uint8_t idlerStatus;	   // INACTIVE, ACTIVE, QUICKPARKED
+	uint8_t loaded;			   // FINDA saw filament
+	uint8_t trackToolChanges;  // tool changes since the last selector resync
+	int16_t bearingPosition;   // idler, oldBearingPosition
+	int16_t selectorPosition;  // selector, currentPosition
+};
+
+extern MechState mechState;
+
+// returns false if there is no valid record of this version
+bool mechstate_load();
+
+void mechstate_motion_begin();
+
+// stores mechState (filled in by the caller) as clean
+void mechstate_motion_end();
+
+#endif // MECHSTATE_H
@@ -1,15 +1,5 @@
 #include "print.h"
-
-/*************************/
-int ENABLE_SSD1306 = 0;
-#ifdef SSD1306
-#define SCREEN_WIDTH 128 // OLED display width, in pixels
-#define SCREEN_HEIGHT 64 // OLED display height, in pixels
-
-// Declaration for an SSD1306 display connected to I2C (SDA, SCL pins)
-#define OLED_RESET -1 // Reset pin # (or -1 if sharing Arduino reset pin)
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-#endif
+#include <stdarg.h>
 
 IOPrint::IOPrint()
 {
@@ -27,141 +17,129 @@ void IOPrint::setup()
     }
     
 #endif
-#ifdef SSD1306
-    ENABLE_SSD1306 = 1;
-    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-    if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C))
-    { // Address 0x3D for 128x64
-        Serial.println(F("SSD1306 allocation failed"));
-        ENABLE_SSD1306 = 0;
-    }
-    if (ENABLE_SSD1306)
-    {
-        display.display();
-        delay(200); // Pause for 2 seconds
-
-        // Clear the buffer
-        display.clearDisplay();
-    }
-#endif
 }
 
-void manage_screen()
+/*************************/
+// Deferred logging
+//
+// The log functions only copy the message into logBuffer, they never wait on the
+// serial port. log_drain() is called from the idle points of the firmware and sends
+// what the TX buffer can take without blocking. A message that does not fit in the
+// ring is dropped as a whole and counted.
+/*************************/
+static char logBuffer[LOG_BUFFER_SIZE];
+static uint16_t logHead = 0; // next byte written
+static uint16_t logTail = 0; // next byte drained
+static unsigned long logDroppedMessages = 0;
+static unsigned long logDroppedBytes = 0;
+static unsigned long logReportedDrops = 0;
+
+static uint16_t log_free()
 {
-    #ifdef SSD1306
-    display.clearDisplay();
-    display.setTextSize(1);      // Normal 1:1 pixel scale
-    display.setTextColor(WHITE); // Draw white text
-    display.setCursor(0, 0);     // Start at top-left corner
-    display.cp437(true);         // Use full 256 char 'Code Page 437' font
-    #endif
+    return (LOG_BUFFER_SIZE - 1) - ((logHead - logTail + LOG_BUFFER_SIZE) % LOG_BUFFER_SIZE);
 }
-void println_log(const __FlashStringHelper *msg)
+
+static void log_push(char c)
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    logBuffer[logHead] = c;
+    logHead = (logHead + 1) % LOG_BUFFER_SIZE;
 }
 
-void println_log(const char *msg)
+static bool log_reserve(uint16_t length)
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    if (length > log_free())
+    {
+        logDroppedMessages++;
+        logDroppedBytes += length;
+        return false;
+    }
+    return true;
 }
 
-void println_log(String msg)
+static void log_write(const char *msg)
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    uint16_t length = strlen(msg);
+
+    if (!log_reserve(length + 1))
+        return;
+    while (*msg)
+        log_push(*msg++);
+    log_push('\n');
 }
 
-void println_log(int msg)
+unsigned long log_dropped_messages()
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    return logDroppedMessages;
 }
 
-void println_log(unsigned int msg)
+unsigned long log_dropped_bytes()
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    return logDroppedBytes;
 }
 
-void println_log(char msg)
+bool log_pending()
 {
 #ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
+    return (logTail != logHead) && (Serial.availableForWrite() > 0);
+#else
+    return logTail != logHead;
 #endif
 }
 
-void print_log(const __FlashStringHelper *msg)
+void log_drain()
 {
+    char c;
+
+    // report the overflow once there is room again
+    if ((logDroppedMessages != logReportedDrops) && (log_free() >= 48))
+    {
+        logReportedDrops = logDroppedMessages;
+        LOG_WARN("log: messages dropped: %lu", logDroppedMessages);
+    }
+
+    while (logTail != logHead)
+    {
 #ifdef SERIAL_DEBUG
-    Serial.print(msg);
+        if (Serial.availableForWrite() <= 0)
+            return; // TX buffer full, try again at the next idle point
 #endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
+        c = logBuffer[logTail];
+        logTail = (logTail + 1) % LOG_BUFFER_SIZE;
+#ifdef SERIAL_DEBUG
+        Serial.write(c);
 #endif
+    }
 }
 
-void print_log(const char *msg)
+void log_flush()
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    while (logTail != logHead)
+        log_drain();
 }
 
-void print_log(String msg)
+#ifdef LOG_TOKENIZED
+void log_frame(const uint8_t *frame, uint8_t length)
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
+    if (!log_reserve(length + 2))
+        return;
+    log_push(LOG_TOKEN_FRAME_START);
+    log_push(length);
+    while (length--)
+        log_push(*frame++);
 }
+#endif
 
-void print_log(char msg)
+void log_printf_P(const char *fmt, ...)
 {
-#ifdef SERIAL_DEBUG
-    Serial.println(msg);
-#endif
-#ifdef SSD1306
-    manage_screen();
-    display.println(msg);
-#endif
-}
\ No newline at end of file
+    char line[LOG_LINE_SIZE];
+    va_list args;
+
+    va_start(args, fmt);
+#ifdef __AVR__
+    vsnprintf_P(line, sizeof(line), fmt, args);
+#else
+    vsnprintf(line, sizeof(line), fmt, args);
+#endif
+    va_end(args);
+    log_write(line);
+}
@@ -3,14 +3,8 @@
 
 #include <Arduino.h>
 
-// SSD1306 SCREEN
+// SSD1306 SCREEN (status screen, see status.h)
 //#define SSD1306
-#ifdef SSD1306
-#include <SPI.h>
-#include <Wire.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
-#endif
 
 /*************************/
 // http://www.geeetech.com/wiki/images/9/90/GT2560_sch.pdf
@@ -37,26 +31,79 @@
 
 #define SERIAL_DEBUG
 
+/*************************/
+// Log levels
+//
+// LOG_ERROR() .. LOG_DEBUG() take a printf format string, which is kept in flash,
+// and always terminate the line. Levels above LOG_LEVEL compile to nothing (the
+// arguments are not even evaluated). Formatting is done on the stack, never on the heap.
+/*************************/
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// longest formatted log line, longer ones are truncated
+#define LOG_LINE_SIZE 128
 
-void println_log(const __FlashStringHelper *msg);
+// optional build mode: send a numeric token and binary arguments instead of the text (see logtoken.h)
+//#define LOG_TOKENIZED
+#ifdef LOG_TOKENIZED
+#include "logtoken.h"
+#define LOG_EMIT(fmt, ...) log_tokenized(LOG_TOKEN(fmt), ##__VA_ARGS__)
+#else
+#define LOG_EMIT(fmt, ...) log_printf_P(PSTR(fmt), ##__VA_ARGS__)
+#endif
 
-void println_log(const char *msg);
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) LOG_EMIT(fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) LOG_EMIT(fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) LOG_EMIT(fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) LOG_EMIT(fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do {} while (0)
+#endif
 
-void println_log(String msg);
+// format (fmt is in flash) and queue one log line, use the LOG_xxx() macros
+void log_printf_P(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 
-void println_log(int msg);
+// size of the deferred log ring buffer (bytes)
+#ifdef __AVR__
+#define LOG_BUFFER_SIZE 256
+#else
+#define LOG_BUFFER_SIZE 1024
+#endif
 
-void println_log(unsigned int msg);
+// send the pending log bytes without blocking, call it when the MMU is idle
+void log_drain();
 
-void println_log(char msg);
+// true when log_drain() has bytes to send and room to send them
+bool log_pending();
 
-void print_log(const __FlashStringHelper *msg);
+// wait until everything is sent, only for reports requested from the debug console
+void log_flush();
 
-void print_log(const char *msg);
+unsigned long log_dropped_messages();
 
-void print_log(String msg);
+unsigned long log_dropped_bytes();
 
-void print_log(char msg);
 
 class IOPrint
 {
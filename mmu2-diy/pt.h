@@ -0,0 +1,85 @@
+#ifndef PT_H
+#define PT_H
+
+/*************************/
+// Protothreads: stackless coroutines
+//
+// A thread is a function returning PT_WAITING / PT_YIELDED while it has more to
+// do and PT_ENDED / PT_EXITED when it is done; it is called again and again
+// (PT_SCHEDULE()) and resumes after the wait point it returned from. The resume
+// point is the source line, kept in struct pt, through a switch statement, so:
+//   - locals do not survive a wait point: keep the state in static variables
+//   - no switch statement around a wait point inside a thread body
+// The usage follows Adam Dunkels' protothreads.
+/*************************/
+
+struct pt
+{
+	unsigned short lc; // line to resume at, 0: start
+};
+
+#define PT_WAITING 0
+#define PT_YIELDED 1
+#define PT_EXITED 2
+#define PT_ENDED 3
+
+#define PT_THREAD(name_args) char name_args
+
+#define PT_INIT(pt) ((pt)->lc = 0)
+
+#define PT_BEGIN(pt)             \
+	{                            \
+		char PT_YIELD_FLAG = 1;  \
+		(void)PT_YIELD_FLAG;     \
+		switch ((pt)->lc)        \
+		{                        \
+		case 0:
+
+#define PT_END(pt)      \
+	}                   \
+	PT_INIT(pt);        \
+	return PT_ENDED;    \
+	}
+
+// wait (returning PT_WAITING) until the condition is true
+#define PT_WAIT_UNTIL(pt, condition) \
+	do                               \
+	{                                \
+		(pt)->lc = __LINE__;         \
+	case __LINE__:                   \
+		if (!(condition))            \
+			return PT_WAITING;       \
+	} while (0)
+
+#define PT_WAIT_WHILE(pt, condition) PT_WAIT_UNTIL((pt), !(condition))
+
+// give the other tasks one turn
+#define PT_YIELD(pt)                \
+	do                              \
+	{                               \
+		PT_YIELD_FLAG = 0;          \
+		(pt)->lc = __LINE__;        \
+	case __LINE__:                  \
+		if (PT_YIELD_FLAG == 0)     \
+			return PT_YIELDED;      \
+	} while (0)
+
+// true while the thread has not ended
+#define PT_SCHEDULE(f) ((f) < PT_EXITED)
+
+// run a child thread to its end, yielding whenever it does
+#define PT_SPAWN(pt, child, thread)               \
+	do                                            \
+	{                                             \
+		PT_INIT((child));                         \
+		PT_WAIT_WHILE((pt), PT_SCHEDULE(thread)); \
+	} while (0)
+
+#define PT_EXIT(pt)           \
+	do                        \
+	{                         \
+		PT_INIT(pt);          \
+		return PT_EXITED;     \
+	} while (0)
+
+#endif // PT_H
@@ -0,0 +1,93 @@
+#include "raminfo.h"
+#include "print.h"
+
+#if defined(__AVR__)
+extern "C" uint8_t __data_start;
+extern "C" uint8_t __bss_end;
+extern "C" uint8_t __heap_start;
+extern "C" uint8_t *__brkval;
+#define RAM_DATA_START (&__data_start)
+#define RAM_BSS_END (&__bss_end)
+#define RAM_HEAP_START (&__heap_start)
+#define RAM_END ((uint8_t *)RAMEND)
+
+static uint8_t *ram_heap_top()
+{
+	return __brkval ? __brkval : &__heap_start;
+}
+
+// runs before the C runtime init, nothing uses the stack yet
+void ram_paint_stack_early() __attribute__((naked, used, section(".init3")));
+void ram_paint_stack_early()
+{
+	uint8_t *p = RAM_HEAP_START;
+
+	while (p <= RAM_END)
+		*p++ = STACK_CANARY;
+}
+
+void ram_paint_stack()
+{
+	// done in .init3
+}
+#elif defined(__STM32F1__)
+// libmaple (mmu-skrmini), symbols from the variant's common.inc
+#include <unistd.h>
+extern "C" uint8_t __data_start__;
+extern "C" uint8_t __bss_end__;
+extern "C" uint8_t __msp_init;
+#define RAM_DATA_START (&__data_start__)
+#define RAM_BSS_END (&__bss_end__)
+#define RAM_HEAP_START (&__bss_end__)
+#define RAM_END (&__msp_init)
+
+static uint8_t *ram_heap_top()
+{
+	return (uint8_t *)sbrk(0);
+}
+
+void ram_paint_stack()
+{
+	uint8_t marker;
+	uint8_t *p = ram_heap_top();
+
+	// keep clear of the frames below the current one
+	while (p < &marker - 64)
+		*p++ = STACK_CANARY;
+}
+#else
+// native build, no memory map to report
+void ram_paint_stack()
+{
+}
+#endif
+
+void ram_info(RamInfo *info)
+{
+	memset(info, 0, sizeof(RamInfo));
+#ifdef RAM_END
+	uint8_t marker;
+	uint8_t *heapTop = ram_heap_top();
+	uint8_t *p = heapTop;
+
+	info->staticRam = RAM_BSS_END - RAM_DATA_START;
+	info->heapUsed = heapTop - RAM_HEAP_START;
+	info->freeRam = &marker - heapTop;
+	info->stackUsed = RAM_END - &marker;
+
+	// first byte above the heap that was written by the stack
+	while ((p < &marker) && (*p == STACK_CANARY))
+		p++;
+	info->neverUsed = p - heapTop;
+	info->stackPeak = RAM_END - p;
+#endif
+}
+
+void ram_report()
+{
+	RamInfo info;
+
+	ram_info(&info);
+	LOG_INFO("RAM static: %u heap: %u free: %u", info.staticRam, info.heapUsed, info.freeRam);
+	LOG_INFO("stack now: %u peak: %u never used: %u", info.stackUsed, info.stackPeak, info.neverUsed);
+}
@@ -0,0 +1,33 @@
+#ifndef RAMINFO_H
+#define RAMINFO_H
+
+#include <Arduino.h>
+
+/*************************/
+// RAM usage
+//
+// The free area between the end of the heap and the stack is painted with
+// STACK_CANARY at boot (from .init3 on AVR, at the start of setup() elsewhere).
+// The high-water mark is the deepest stack byte that no longer holds the canary.
+/*************************/
+
+#define STACK_CANARY 0xC5
+
+struct RamInfo
+{
+	unsigned int staticRam; // .data + .bss
+	unsigned int heapUsed;	// from the end of .bss to the heap top
+	unsigned int freeRam;	// between the heap top and the current stack pointer
+	unsigned int stackUsed; // current stack depth
+	unsigned int stackPeak; // deepest stack seen since boot (high-water mark)
+	unsigned int neverUsed; // painted bytes never touched (worst case headroom)
+};
+
+// paint the free RAM (no-op on AVR, done before main() there)
+void ram_paint_stack();
+
+void ram_info(RamInfo *info);
+
+void ram_report();
+
+#endif // RAMINFO_H
@@ -0,0 +1,227 @@
+#include "recorder.h"
+
+#ifdef FIELD_RECORDER
+#include "print.h"
+
+#ifndef SERIAL_DEBUG
+#error "FIELD_RECORDER sends its entries on the debug console (SERIAL_DEBUG in print.h)"
+#endif
+
+#if (RECORDER_SIZE & (RECORDER_SIZE - 1)) != 0
+#error "RECORDER_SIZE must be a power of two"
+#endif
+
+#define RECORDER_LINE_LENGTH (2 + RECORDER_LINE_ENTRIES * 8 + 1) // "R " entries '\n'
+#define RECORDER_IDLE_US 60000000ul // a gap entry after a minute without any
+
+struct RecorderEntry
+{
+	uint16_t ticks;
+	uint8_t channel;
+	uint8_t value;
+};
+
+static RecorderEntry recorderRing[RECORDER_SIZE];
+static uint16_t recorderHead = 0;  // next entry written
+static uint16_t recorderTail = 0;  // next entry sent
+static unsigned long recorderLast; // micros() of the previous entry, less the fraction of a tick not counted yet
+static unsigned long recorderEpoch;
+static unsigned long recorderLost = 0;
+static unsigned long recorderReportedLost = 0;
+static uint8_t recorderLevels[3]; // last level recorded, per sensor channel
+static int recorderWaiting[2];	  // bytes seen by available() and not read yet: printer, console
+static unsigned long recorderReads[5]; // micros() of the previous read per sensor channel, then per port
+
+RecorderSerial recorderSerial1;
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static uint16_t recorder_free()
+{
+	return (RECORDER_SIZE - 1) - ((recorderHead - recorderTail) & (RECORDER_SIZE - 1));
+}
+
+static void recorder_push(uint16_t ticks, uint8_t channel, uint8_t value)
+{
+	RecorderEntry *entry = &recorderRing[recorderHead];
+
+	entry->ticks = ticks;
+	entry->channel = channel;
+	entry->value = value;
+	recorderHead = (recorderHead + 1) & (RECORDER_SIZE - 1);
+}
+
+// now: micros() of the event, since: of the previous read, that did not find its input yet (0: none)
+static void recorder_event(uint8_t channel, uint8_t value, unsigned long now, unsigned long since = 0)
+{
+	unsigned long ticks = (now - recorderLast) / RECORDER_TICK_US;
+	uint8_t needed = (since != 0) + 1;
+	unsigned long rest;
+	uint8_t chunk;
+
+	// what does not fit in the 16 bits of the entry goes before it, in gap entries
+	for (rest = ticks >> 16; rest; rest -= chunk)
+	{
+		chunk = (rest > 255) ? 255 : rest;
+		needed++;
+	}
+	if (recorder_free() < needed)
+	{
+		recorderLost++; // its time goes to the next entry
+		return;
+	}
+	recorderLast += ticks * RECORDER_TICK_US;
+	for (rest = ticks >> 16; rest; rest -= chunk)
+	{
+		chunk = (rest > 255) ? 255 : rest;
+		recorder_push(0, RECORDER_GAP, chunk);
+	}
+	if (since)
+	{
+		rest = (recorderLast - since) / RECORDER_TICK_US;
+		recorder_push((rest > 0xFFFF) ? 0xFFFF : rest, RECORDER_SINCE, channel);
+	}
+	recorder_push(ticks & 0xFFFF, channel, value);
+}
+
+void recorder_begin()
+{
+	recorderHead = recorderTail = 0;
+	memset(recorderLevels, 0xFF, sizeof(recorderLevels));
+	recorderWaiting[0] = recorderWaiting[1] = 0;
+	memset(recorderReads, 0, sizeof(recorderReads));
+	log_flush();
+	Serial.print(F("R BEGIN "));
+	Serial.print(RECORDER_TICK_US);
+	Serial.write('\n');
+	recorderEpoch = recorderLast = micros();
+}
+
+unsigned long recorder_epoch()
+{
+	return recorderEpoch;
+}
+
+void recorder_input(uint8_t pin, uint8_t level)
+{
+	uint8_t channel;
+	unsigned long now = micros();
+	unsigned long since;
+
+	if (pin == findaPin)
+		channel = RECORDER_FINDA;
+	else if (pin == filamentSwitch)
+		channel = RECORDER_SWITCH;
+	else if (pin == colorSelectorEnstop)
+		channel = RECORDER_ENDSTOP;
+	else
+		return;
+	since = recorderReads[channel - RECORDER_FINDA];
+	recorderReads[channel - RECORDER_FINDA] = now;
+	if (recorderLevels[channel - RECORDER_FINDA] == level)
+		return;
+	recorderLevels[channel - RECORDER_FINDA] = level;
+	recorder_event(channel, level, now, since);
+}
+
+void recorder_available(uint8_t channel, int count)
+{
+	int *waiting = &recorderWaiting[channel == RECORDER_CONSOLE];
+	unsigned long *read = &recorderReads[3 + (channel == RECORDER_CONSOLE)];
+	unsigned long now = micros();
+	unsigned long since = *read;
+
+	*read = now;
+	if (count <= *waiting)
+		return;
+	recorder_event((channel == RECORDER_CONSOLE) ? RECORDER_CONSOLE_SEEN : RECORDER_RX_SEEN, count - *waiting, now, since);
+	*waiting = count;
+}
+
+void recorder_byte(uint8_t channel, int c)
+{
+	int *waiting = &recorderWaiting[channel == RECORDER_CONSOLE];
+
+	if (c < 0)
+		return;
+	if (!*waiting)
+		recorder_available(channel, 1); // read without asking first
+	(*waiting)--;
+	recorder_event(channel, c, micros());
+}
+
+void recorder_storage(uint8_t key, const void *data, uint8_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	// only at boot: waits for the console
+	log_flush();
+	Serial.print(F("R S "));
+	Serial.print(key);
+	Serial.print(' ');
+	while (size--)
+	{
+		Serial.write(hexDigits[*bytes >> 4]);
+		Serial.write(hexDigits[*bytes++ & 0x0F]);
+	}
+	Serial.write('\n');
+}
+
+bool recorder_pending()
+{
+	if ((recorderHead == recorderTail) && (recorderLost == recorderReportedLost))
+		return false;
+	// whole lines, after the log line that may be on its way
+	return !log_pending() && (Serial.availableForWrite() >= RECORDER_LINE_LENGTH);
+}
+
+void recorder_drain()
+{
+	char line[RECORDER_LINE_LENGTH];
+	uint8_t length = 2;
+	const RecorderEntry *entry;
+
+	if (!recorder_pending())
+		return;
+	if (recorderLost != recorderReportedLost)
+	{
+		recorderReportedLost = recorderLost;
+		Serial.print(F("R LOST "));
+		Serial.print(recorderLost);
+		Serial.write('\n');
+		return;
+	}
+	line[0] = 'R';
+	line[1] = ' ';
+	for (uint8_t i = 0; (i < RECORDER_LINE_ENTRIES) && (recorderTail != recorderHead); i++)
+	{
+		entry = &recorderRing[recorderTail];
+		line[length++] = hexDigits[entry->ticks >> 12];
+		line[length++] = hexDigits[(entry->ticks >> 8) & 0x0F];
+		line[length++] = hexDigits[(entry->ticks >> 4) & 0x0F];
+		line[length++] = hexDigits[entry->ticks & 0x0F];
+		line[length++] = hexDigits[entry->channel >> 4];
+		line[length++] = hexDigits[entry->channel & 0x0F];
+		line[length++] = hexDigits[entry->value >> 4];
+		line[length++] = hexDigits[entry->value & 0x0F];
+		recorderTail = (recorderTail + 1) & (RECORDER_SIZE - 1);
+	}
+	line[length++] = '\n';
+	Serial.write((const uint8_t *)line, length);
+}
+
+void recorder_idle()
+{
+	unsigned long now = micros();
+
+	if ((now - recorderLast) >= RECORDER_IDLE_US)
+		recorder_event(RECORDER_GAP, 0, now);
+}
+
+size_t RecorderSerial::write(uint8_t c)
+{
+	recorder_event(RECORDER_TX, c, micros());
+	return Serial1.write(c);
+}
+
+#endif // FIELD_RECORDER
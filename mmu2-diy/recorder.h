@@ -0,0 +1,122 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/*************************/
+// Field recorder
+//
+// Optional (FIELD_RECORDER in config.h): everything the firmware takes from the
+// outside, with its time, so that a run of a unit in the field can be replayed
+// on a workstation (mmu-replay, pio run -e replay):
+//   - the sensor levels as the firmware read them (FINDA, filament switch,
+//     selector endstop), one entry per change
+//   - the bytes read from and written to the printer (Serial1), and the ones
+//     read from the debug console (the operator's answer to fixTheProblem());
+//     a received byte is timed when available() first reports it, which is
+//     when the firmware could have acted on it, its value when it is read
+//   - for a sensor change and for new bytes, the time of the previous read
+//     that did not see them yet: the change happened in between, where a
+//     faster or slower firmware may look (RECORDER_SINCE)
+//   - the persistent records loaded at boot (calibration, positions, ...)
+//
+// An entry is 4 bytes: the time since the previous entry in RECORDER_TICK_US
+// ticks, a channel and a value. The entries go to a RAM ring and are sent on the
+// debug console at the idle points, like the log: one "R <hex>" line holds up
+// to RECORDER_LINE_ENTRIES entries, "R LOST <n>" reports entries dropped on a
+// full ring (the replay then stops being exact). The records are written
+// out as they are loaded: "R S <key> <hex>". Every sensor read and available()
+// costs a micros() more than without the recorder.
+//
+// "R BEGIN <tick us>" starts the entries of one boot. Any terminal that logs the console
+// to a file will do (pio device monitor --filter log2file): the replay skips
+// the lines that are not its own.
+//
+// Without FIELD_RECORDER the RECORD_xxx() macros compile to nothing and
+// PRINTER_SERIAL is Serial1.
+/*************************/
+
+// channels, value in brackets
+#define RECORDER_GAP 0	   // no event, only time: dt + value * 65536 ticks
+#define RECORDER_FINDA 1   // FINDA read (level)
+#define RECORDER_SWITCH 2  // extruder filament switch read (level)
+#define RECORDER_ENDSTOP 3 // selector endstop read (level)
+#define RECORDER_RX 4	   // byte read from the printer (byte)
+#define RECORDER_TX 5	   // byte written to the printer (byte)
+#define RECORDER_CONSOLE 6 // byte read from the debug console: operator, console commands (byte)
+#define RECORDER_RX_SEEN 7 // bytes from the printer the firmware found waiting (count)
+#define RECORDER_CONSOLE_SEEN 8 // same for the debug console (count)
+#define RECORDER_SINCE 9   // before a sensor or SEEN entry, no time of its own: its ticks are
+						   // the time from the previous read that did not see it, 0xFFFF or more (channel)
+
+// time resolution of the entries: the one of micros()
+#ifdef __AVR__
+#define RECORDER_TICK_US 4
+#else
+#define RECORDER_TICK_US 1
+#endif
+#define RECORDER_LINE_ENTRIES 6
+
+// number of entries buffered between two drains, a power of two
+#ifndef RECORDER_SIZE
+#ifdef __AVR__
+#define RECORDER_SIZE 64
+#else
+#define RECORDER_SIZE 512
+#endif
+#endif
+
+#ifdef FIELD_RECORDER
+
+// first thing in setup(), after the debug console: starts the clock of the entries
+void recorder_begin();
+
+// micros() at recorder_begin(): time 0 of the entries
+unsigned long recorder_epoch();
+
+// pin is one of findaPin, filamentSwitch, colorSelectorEnstop: every read, recorded when the level changes
+void recorder_input(uint8_t pin, uint8_t level);
+
+// channel RECORDER_RX or RECORDER_CONSOLE: every result of available(), every read() (-1: nothing)
+void recorder_available(uint8_t channel, int count);
+void recorder_byte(uint8_t channel, int c);
+
+// a persistent record loaded by storage_load(), sent at once
+void recorder_storage(uint8_t key, const void *data, uint8_t size);
+
+// scheduler task: true when there are entries and room for a line on the console
+bool recorder_pending();
+void recorder_drain();
+
+// from the maintenance task: keeps the time of the entries exact over a long idle period
+void recorder_idle();
+
+// the printer port as seen by the firmware: writes are recorded, then go to Serial1
+class RecorderSerial : public Print
+{
+public:
+	size_t write(uint8_t c) override;
+	using Print::write;
+};
+
+extern RecorderSerial recorderSerial1;
+
+#define PRINTER_SERIAL recorderSerial1
+#define RECORD_INPUT(pin, level) recorder_input(pin, level)
+#define RECORD_RX_AVAILABLE(count) recorder_available(RECORDER_RX, count)
+#define RECORD_RX(c) recorder_byte(RECORDER_RX, c)
+#define RECORD_CONSOLE_AVAILABLE(count) recorder_available(RECORDER_CONSOLE, count)
+#define RECORD_CONSOLE(c) recorder_byte(RECORDER_CONSOLE, c)
+#define RECORD_STORAGE(key, data, size) recorder_storage(key, data, size)
+#else
+#define PRINTER_SERIAL Serial1
+#define RECORD_INPUT(pin, level) do {} while (0)
+#define RECORD_RX_AVAILABLE(count) do {} while (0)
+#define RECORD_RX(c) do {} while (0)
+#define RECORD_CONSOLE_AVAILABLE(count) do {} while (0)
+#define RECORD_CONSOLE(c) do {} while (0)
+#define RECORD_STORAGE(key, data, size) do {} while (0)
+#endif
+
+#endif // RECORDER_H
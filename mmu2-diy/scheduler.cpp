@@ -0,0 +1,36 @@
+#include "scheduler.h"
+
+static Task *schedulerTasks = NULL;
+static uint8_t schedulerTaskCount = 0;
+
+void scheduler_setup(Task *tasks, uint8_t count)
+{
+	schedulerTasks = tasks;
+	schedulerTaskCount = count;
+	for (uint8_t i = 0; i < count; i++)
+		tasks[i].lastRun = millis();
+}
+
+static bool scheduler_due(Task *task, unsigned long now)
+{
+	if (task->ready && task->ready())
+		return true;
+	return task->periodMs && ((now - task->lastRun) >= task->periodMs);
+}
+
+bool scheduler_run()
+{
+	unsigned long now = millis();
+
+	for (uint8_t i = 0; i < schedulerTaskCount; i++)
+	{
+		Task *task = &schedulerTasks[i];
+
+		if (!scheduler_due(task, now))
+			continue;
+		task->lastRun = now;
+		task->run();
+		return true;
+	}
+	return false;
+}
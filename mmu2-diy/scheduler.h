@@ -0,0 +1,34 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+/*************************/
+// Cooperative scheduler with static priorities
+//
+// The task table is ordered by priority, the first entry is the most urgent.
+// A task is due when its ready() function returns true (event, polled on every
+// pass: ready() only tests a flag or a buffer) or when its period has elapsed.
+// scheduler_run() runs the first due task and returns, so a busy low priority
+// task can't hold back the higher ones by more than one run.
+// Tasks run to completion and must return quickly: a motion command is a
+// protothread that returns at each of its wait points (motionStep()).
+/*************************/
+
+typedef void (*TaskFunction)();
+typedef bool (*TaskReady)();
+
+struct Task
+{
+	TaskFunction run;
+	TaskReady ready;   // NULL: not event driven
+	uint16_t periodMs; // 0: not periodic
+	unsigned long lastRun;
+};
+
+void scheduler_setup(Task *tasks, uint8_t count);
+
+// runs the highest priority due task, returns false if there was none
+bool scheduler_run();
+
+#endif // SCHEDULER_H
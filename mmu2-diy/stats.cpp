@@ -0,0 +1,96 @@
+#include "stats.h"
+#include "storage.h"
+#include "print.h"
+
+Stats stats;
+
+static const uint16_t statsBucketBounds[STATS_BUCKETS - 1] = STATS_BUCKET_BOUNDS;
+static bool statsDirty = false;
+static unsigned long statsLastSave = 0;
+
+void stats_load()
+{
+	if (!storage_load(STORAGE_KEY_STATS, &stats, sizeof(stats)) || (stats.version != STATS_VERSION))
+	{
+		LOG_INFO("stats: no stored counters, starting from zero");
+		memset(&stats, 0, sizeof(stats));
+		stats.version = STATS_VERSION;
+	}
+}
+
+void stats_swap(uint8_t slot)
+{
+	if (slot < 5)
+		stats.swaps[slot]++;
+	statsDirty = true;
+}
+
+void stats_failure(uint8_t failure)
+{
+	if ((failure < STATS_FAILURES) && (stats.failures[failure] < 0xFFFF))
+		stats.failures[failure]++;
+	statsDirty = true;
+}
+
+void stats_steps(uint8_t axis, uint32_t steps)
+{
+	stats.steps[axis] += steps;
+	statsDirty = true;
+}
+
+void stats_phase(uint8_t phase, unsigned long ms)
+{
+	uint8_t bucket = 0;
+
+	while ((bucket < STATS_BUCKETS - 1) && (ms > statsBucketBounds[bucket]))
+		bucket++;
+	if (stats.histogram[phase][bucket] < 0xFFFF)
+		stats.histogram[phase][bucket]++;
+	stats.phaseMs[phase] += ms;
+	statsDirty = true;
+}
+
+void stats_idle()
+{
+	if (!statsDirty || ((millis() - statsLastSave) < STATS_SAVE_INTERVAL))
+		return;
+	if (storage_save(STORAGE_KEY_STATS, &stats, sizeof(stats)) == STORAGE_FAILED)
+		LOG_WARN("stats: write failed");
+	statsDirty = false;
+	statsLastSave = millis();
+}
+
+void stats_reset()
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.version = STATS_VERSION;
+	statsDirty = true;
+	statsLastSave = millis() - STATS_SAVE_INTERVAL; // store at the next idle point
+}
+
+void stats_report()
+{
+#if LOG_LEVEL >= LOG_LEVEL_INFO // all of it is log output
+	static const char phaseNames[STATS_PHASES][8] = {"unload", "select", "feed", "C"};
+
+	LOG_INFO("swaps: %lu %lu %lu %lu %lu", (unsigned long)stats.swaps[0], (unsigned long)stats.swaps[1],
+			 (unsigned long)stats.swaps[2], (unsigned long)stats.swaps[3], (unsigned long)stats.swaps[4]);
+	LOG_INFO("failures: selector %u, L finda %u, unload extruder %u, unload bowden %u",
+			 stats.failures[STATS_FAIL_SELECTOR_BLOCKED], stats.failures[STATS_FAIL_LOAD_FINDA],
+			 stats.failures[STATS_FAIL_UNLOAD_EXTRUDER], stats.failures[STATS_FAIL_UNLOAD_BOWDEN]);
+	LOG_INFO("failures: feed finda %u, switch stuck %u, feed extruder %u, C extruder %u",
+			 stats.failures[STATS_FAIL_FEED_FINDA], stats.failures[STATS_FAIL_SWITCH_STUCK],
+			 stats.failures[STATS_FAIL_FEED_EXTRUDER], stats.failures[STATS_FAIL_C_EXTRUDER]);
+	LOG_INFO("steps: idler %lu, selector %lu, extruder %lu", (unsigned long)stats.steps[STATS_AXIS_IDLER],
+			 (unsigned long)stats.steps[STATS_AXIS_SELECTOR], (unsigned long)stats.steps[STATS_AXIS_EXTRUDER]);
+	log_flush();
+	LOG_INFO("PHASE  | TOTAL (s) | <=250 <=500 <=1k <=2k <=4k <=8k <=16k >16k (ms)");
+	for (uint8_t i = 0; i < STATS_PHASES; i++)
+	{
+		uint16_t *h = stats.histogram[i];
+		LOG_INFO("%-6s | %lu | %u %u %u %u %u %u %u %u", phaseNames[i], (unsigned long)(stats.phaseMs[i] / 1000),
+				 h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7]);
+		log_flush();
+	}
+#endif
+}
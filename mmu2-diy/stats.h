@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <Arduino.h>
+
+/*************************/
+// Lifetime counters and phase histograms
+//
+// Swaps per slot, failures by type, motor steps per axis and the time spent in
+// each phase of a filament change, plus a fixed-bucket histogram of the phase
+// durations. Kept in RAM, stored with storage_save() from stats_idle() when they
+// changed, at most every STATS_SAVE_INTERVAL ms, and loaded at boot.
+/*************************/
+
+// bump when the layout of Stats changes
+#define STATS_VERSION 1
+
+#define STATS_SAVE_INTERVAL 300000ul // ms, bounds the EEPROM / flash wear
+
+// phases of a filament change
+#define STATS_PHASE_UNLOAD 0 // back to the FINDA
+#define STATS_PHASE_SELECT 1 // idler and selector moves
+#define STATS_PHASE_FEED 2	 // bowden feed to the extruder
+#define STATS_PHASE_C 3		 // 'C' command, into the extruder gears
+#define STATS_PHASES 4
+
+// failures (one per fixTheProblem() cause)
+#define STATS_FAIL_SELECTOR_BLOCKED 0 // filament in the selector when it has to move
+#define STATS_FAIL_LOAD_FINDA 1		  // 'L': FINDA not reached
+#define STATS_FAIL_UNLOAD_EXTRUDER 2  // stuck in the extruder head
+#define STATS_FAIL_UNLOAD_BOWDEN 3	  // FINDA not cleared
+#define STATS_FAIL_FEED_FINDA 4		  // FINDA not reached on a tool change
+#define STATS_FAIL_SWITCH_STUCK 5	  // extruder filament switch active too early
+#define STATS_FAIL_FEED_EXTRUDER 6	  // extruder filament switch not reached
+#define STATS_FAIL_C_EXTRUDER 7		  // 'C': extruder filament switch not reached
+#define STATS_FAILURES 8
+
+// axes
+#define STATS_AXIS_IDLER 0
+#define STATS_AXIS_SELECTOR 1
+#define STATS_AXIS_EXTRUDER 2
+#define STATS_AXES 3
+
+// histogram buckets: upper bounds in ms, the last one is open ended
+#define STATS_BUCKETS 8
+#define STATS_BUCKET_BOUNDS {250, 500, 1000, 2000, 4000, 8000, 16000}
+
+struct Stats
+{
+	uint8_t version;
+	uint32_t swaps[5];
+	uint16_t failures[STATS_FAILURES];
+	uint32_t steps[STATS_AXES];
+	uint32_t phaseMs[STATS_PHASES];
+	uint16_t histogram[STATS_PHASES][STATS_BUCKETS];
+};
+
+extern Stats stats;
+
+void stats_load();
+
+void stats_swap(uint8_t slot);
+
+void stats_failure(uint8_t failure);
+
+void stats_steps(uint8_t axis, uint32_t steps);
+
+void stats_phase(uint8_t phase, unsigned long ms);
+
+// stores the counters if they changed and the last save is old enough
+void stats_idle();
+
+void stats_reset();
+
+void stats_report();
+
+#endif // STATS_H
@@ -0,0 +1,197 @@
+#include "status.h"
+#include "print.h"
+#include "application.h"
+
+#ifdef SSD1306
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+
+#define SCREEN_WIDTH 128 // OLED display width, in pixels
+#define SCREEN_HEIGHT 64 // OLED display height, in pixels
+#define SCREEN_ADDRESS 0x3C
+#define SCREEN_I2C_CHUNK 16 // data bytes per I2C transfer (the AVR Wire buffer is 32 bytes)
+
+// Declaration for an SSD1306 display connected to I2C (SDA, SCL pins)
+#define OLED_RESET -1 // Reset pin # (or -1 if sharing Arduino reset pin)
+static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+static bool screenEnabled = false;
+
+struct StatusRegion
+{
+    uint8_t firstPage;
+    uint8_t lastPage;
+    uint8_t textSize;
+};
+
+enum
+{
+    REGION_SLOT,
+    REGION_IDLER,
+    REGION_SENSORS,
+    REGION_SWAP,
+    REGION_ERROR,
+    REGION_COUNT
+};
+
+static const StatusRegion regions[REGION_COUNT] = {
+    {0, 1, 2},
+    {2, 2, 1},
+    {3, 3, 1},
+    {4, 4, 1},
+    {5, 7, 1},
+};
+
+// hash of the text currently shown in each region, and the regions waiting for the I2C push
+static uint16_t regionHash[REGION_COUNT];
+static uint8_t regionDirty = 0;
+static unsigned long lastFrame = 0;
+#endif
+
+static unsigned long lastSwapTime = 0;
+static char errorText[64] = "";
+
+void status_setup()
+{
+#ifdef SSD1306
+    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
+    if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS))
+    {
+        LOG_ERROR("SSD1306 allocation failed");
+        return;
+    }
+    screenEnabled = true;
+    display.clearDisplay();
+    display.setTextColor(WHITE);
+    display.cp437(true); // Use full 256 char 'Code Page 437' font
+    display.display();
+    memset(regionHash, 0xFF, sizeof(regionHash)); // force the first draw
+#endif
+}
+
+void status_swap_time(unsigned long ms)
+{
+    lastSwapTime = ms;
+}
+
+void status_error(const char *msg)
+{
+    if (msg)
+    {
+        strncpy(errorText, msg, sizeof(errorText) - 1);
+        errorText[sizeof(errorText) - 1] = 0;
+    }
+    else
+    {
+        errorText[0] = 0;
+    }
+}
+
+#ifdef SSD1306
+static uint16_t status_hash(const char *text)
+{
+    uint16_t hash = 5381;
+    while (*text)
+        hash = (hash * 33) ^ (uint8_t)*text++;
+    return hash;
+}
+
+static void status_format(uint8_t region, char *text, uint8_t size)
+{
+    static const char *const idlerStates[] = {"PARKED", "ENGAGED", "QUICK PARK"};
+
+    switch (region)
+    {
+    case REGION_SLOT:
+        snprintf(text, size, "SLOT %d", filamentSelection);
+        break;
+    case REGION_IDLER:
+        snprintf(text, size, "IDLER %s", (idlerStatus >= 0 && idlerStatus <= 2) ? idlerStates[idlerStatus] : "?");
+        break;
+    case REGION_SENSORS:
+        snprintf(text, size, "FINDA %-3s FSENS %s", isFilamentLoadedPinda() ? "ON" : "OFF", isFilamentLoadedtoExtruder() ? "ON" : "OFF");
+        break;
+    case REGION_SWAP:
+        snprintf(text, size, "LAST SWAP %lu.%lus", lastSwapTime / 1000, (lastSwapTime % 1000) / 100);
+        break;
+    case REGION_ERROR:
+        snprintf(text, size, "%s", errorText);
+        break;
+    }
+}
+
+static void status_draw(uint8_t region, const char *text)
+{
+    const StatusRegion *r = &regions[region];
+
+    display.fillRect(0, r->firstPage * 8, SCREEN_WIDTH, (r->lastPage - r->firstPage + 1) * 8, BLACK);
+    display.setTextSize(r->textSize);
+    display.setTextWrap(true);
+    display.setCursor(0, r->firstPage * 8);
+    display.print(text);
+}
+
+// send the pages of one region from the frame buffer to the panel
+static void status_push(uint8_t region)
+{
+    const StatusRegion *r = &regions[region];
+    const uint8_t *buffer = display.getBuffer() + r->firstPage * SCREEN_WIDTH;
+    uint16_t length = (r->lastPage - r->firstPage + 1) * SCREEN_WIDTH;
+
+    display.ssd1306_command(SSD1306_PAGEADDR);
+    display.ssd1306_command(r->firstPage);
+    display.ssd1306_command(r->lastPage);
+    display.ssd1306_command(SSD1306_COLUMNADDR);
+    display.ssd1306_command(0);
+    display.ssd1306_command(SCREEN_WIDTH - 1);
+
+    for (uint16_t i = 0; i < length; i += SCREEN_I2C_CHUNK)
+    {
+        Wire.beginTransmission(SCREEN_ADDRESS);
+        Wire.write((uint8_t)0x40); // data stream
+        Wire.write(buffer + i, SCREEN_I2C_CHUNK);
+        Wire.endTransmission();
+    }
+}
+#endif
+
+void status_refresh()
+{
+#ifdef SSD1306
+    char text[64];
+    uint16_t hash;
+
+    if (!screenEnabled)
+        return;
+
+    // first send what is left over from the last frame
+    if (regionDirty)
+    {
+        for (uint8_t region = 0; region < REGION_COUNT; region++)
+        {
+            if (regionDirty & (1 << region))
+            {
+                regionDirty &= ~(1 << region);
+                status_push(region);
+                return;
+            }
+        }
+    }
+
+    if ((millis() - lastFrame) < STATUS_FRAME_INTERVAL)
+        return;
+    lastFrame = millis();
+
+    for (uint8_t region = 0; region < REGION_COUNT; region++)
+    {
+        status_format(region, text, sizeof(text));
+        hash = status_hash(text);
+        if (hash != regionHash[region])
+        {
+            regionHash[region] = hash;
+            status_draw(region, text);
+            regionDirty |= 1 << region;
+        }
+    }
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <Arduino.h>
+
+/*************************/
+// SSD1306 status screen (enable SSD1306 in print.h)
+//
+// The 128x64 panel is split in fixed regions, each one a range of display pages:
+//   pages 0-1 : active slot (double size)
+//   page  2   : idler state
+//   page  3   : FINDA / extruder filament switch
+//   page  4   : duration of the last tool change
+//   pages 5-7 : last error
+// status_refresh() is called from the idle points only. It redraws at most
+// STATUS_FRAME_INTERVAL apart and pushes only the regions whose text changed,
+// one region per call, so one call never holds the I2C bus for long.
+/*************************/
+
+#define STATUS_FRAME_INTERVAL 200 // ms between two refreshes (5 frames per second)
+
+void status_setup();
+
+void status_refresh();
+
+// duration of the last completed tool change
+void status_swap_time(unsigned long ms);
+
+// error shown until cleared with NULL
+void status_error(const char *msg);
+
+#endif // STATUS_H
@@ -0,0 +1,222 @@
+#include "storage.h"
+#include "recorder.h"
+#ifdef __STM32F1__
+#include "flashkv.h"
+#else
+#include <EEPROM.h>
+#endif
+
+#define STORAGE_MAGIC 0x4D // 'M'
+#define STORAGE_HEADER_SIZE 4
+#define STORAGE_CRC_SIZE 2
+
+struct StorageArea
+{
+	uint8_t key;
+	uint16_t offset;  // start of the first slot, the others follow
+	uint8_t maxSize;  // largest record payload
+	uint8_t slots;	  // written in turn, at least two
+};
+
+#define STORAGE_SLOT_SIZE(area) (STORAGE_HEADER_SIZE + (area)->maxSize + STORAGE_CRC_SIZE)
+
+static const StorageArea storageAreas[] = {
+	{STORAGE_KEY_CALIBRATION, 0, 48, 2},
+	{STORAGE_KEY_MECHANICAL, 108, 10, 16}, // written twice per motion command, spread the wear
+	{STORAGE_KEY_STATS, 364, 132, 2},
+	{STORAGE_KEY_JOURNAL, 640, 3, 16}, // up to four writes per tool change
+};
+#define STORAGE_AREAS (sizeof(storageAreas) / sizeof(storageAreas[0]))
+
+uint16_t storage_crc16(const uint8_t *data, uint16_t length, uint16_t crc)
+{
+	// CRC-16/CCITT
+	while (length--)
+	{
+		crc ^= (uint16_t)*data++ << 8;
+		for (uint8_t i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+static const StorageArea *storage_area(uint8_t key)
+{
+	for (uint8_t i = 0; i < STORAGE_AREAS; i++)
+	{
+		if (storageAreas[i].key == key)
+			return &storageAreas[i];
+	}
+	return NULL;
+}
+
+#ifdef __STM32F1__
+/*************************/
+// SKR mini: records go to the flash key/value store (see flashkv.h), the slot
+// layout is not needed there. The store asks for a compaction at 3/4 of its
+// page and takes records until the page is full: a record that does not fit
+// is kept here until storage_idle() has compacted the store and can append it.
+/*************************/
+static uint8_t pendingData[STORAGE_AREAS][132]; // largest maxSize
+static uint8_t pendingSize[STORAGE_AREAS]; // 0: nothing pending
+
+bool storage_load(uint8_t key, void *data, uint8_t size)
+{
+	const StorageArea *area = storage_area(key);
+	uint8_t index;
+
+	if (!area || (size > area->maxSize))
+		return false;
+	index = area - storageAreas;
+	if (pendingSize[index] == size)
+	{
+		memcpy(data, pendingData[index], size);
+		RECORD_STORAGE(key, data, size);
+		return true;
+	}
+	if (!flashkv_get(key, data, size))
+		return false;
+	RECORD_STORAGE(key, data, size);
+	return true;
+}
+
+uint8_t storage_save(uint8_t key, const void *data, uint8_t size)
+{
+	const StorageArea *area = storage_area(key);
+	uint8_t index;
+
+	if (!area || (size > area->maxSize) || (size > sizeof(pendingData[0])))
+		return STORAGE_FAILED;
+	index = area - storageAreas;
+	if (flashkv_put(key, data, size))
+	{
+		pendingSize[index] = 0; // older than this one
+		return STORAGE_SAVED;
+	}
+	// the page is full, and the compaction erases: left to storage_idle()
+	memcpy(pendingData[index], data, size);
+	pendingSize[index] = size;
+	return STORAGE_QUEUED;
+}
+
+void storage_idle()
+{
+	flashkv_idle();
+	if (flashkv_compaction_pending())
+		return;
+	for (uint8_t i = 0; i < STORAGE_AREAS; i++)
+	{
+		if (pendingSize[i] && flashkv_put(storageAreas[i].key, pendingData[i], pendingSize[i]))
+			pendingSize[i] = 0;
+	}
+}
+#else
+/*************************/
+// byte access: the AVR EEPROM (a file in the native build)
+/*************************/
+static uint8_t storage_read_byte(uint16_t address)
+{
+	return EEPROM.read(address);
+}
+
+static void storage_write_byte(uint16_t address, uint8_t value)
+{
+	EEPROM.update(address, value); // only writes (and wears) the bytes that change
+}
+
+// checks one slot, returns its sequence number or -1 if it does not hold a valid record
+static int storage_check_slot(uint16_t address, uint8_t key, uint8_t size)
+{
+	uint8_t header[STORAGE_HEADER_SIZE];
+	uint16_t crc, storedCrc;
+	uint8_t value;
+
+	for (uint8_t i = 0; i < STORAGE_HEADER_SIZE; i++)
+		header[i] = storage_read_byte(address + i);
+	if ((header[0] != STORAGE_MAGIC) || (header[1] != key) || (header[2] != size))
+		return -1;
+
+	crc = storage_crc16(header, STORAGE_HEADER_SIZE);
+	for (uint8_t i = 0; i < size; i++)
+	{
+		value = storage_read_byte(address + STORAGE_HEADER_SIZE + i);
+		crc = storage_crc16(&value, 1, crc);
+	}
+	storedCrc = storage_read_byte(address + STORAGE_HEADER_SIZE + size) | (storage_read_byte(address + STORAGE_HEADER_SIZE + size + 1) << 8);
+	return (crc == storedCrc) ? header[3] : -1;
+}
+
+// index of the newest valid slot, -1 if none
+static int storage_current_slot(const StorageArea *area, uint8_t size, uint8_t *sequence)
+{
+	int current = -1;
+	int check;
+
+	for (uint8_t slot = 0; slot < area->slots; slot++)
+	{
+		check = storage_check_slot(area->offset + slot * STORAGE_SLOT_SIZE(area), area->key, size);
+		// sequence numbers wrap around, compare them as a signed difference
+		if ((check >= 0) && ((current < 0) || ((int8_t)(check - *sequence) > 0)))
+		{
+			current = slot;
+			*sequence = check;
+		}
+	}
+	return current;
+}
+
+bool storage_load(uint8_t key, void *data, uint8_t size)
+{
+	const StorageArea *area = storage_area(key);
+	uint8_t sequence;
+	uint16_t address;
+	int slot;
+
+	if (!area || (size > area->maxSize))
+		return false;
+	slot = storage_current_slot(area, size, &sequence);
+	if (slot < 0)
+		return false;
+	address = area->offset + slot * STORAGE_SLOT_SIZE(area) + STORAGE_HEADER_SIZE;
+	for (uint8_t i = 0; i < size; i++)
+		((uint8_t *)data)[i] = storage_read_byte(address + i);
+	RECORD_STORAGE(key, data, size);
+	return true;
+}
+
+uint8_t storage_save(uint8_t key, const void *data, uint8_t size)
+{
+	const StorageArea *area = storage_area(key);
+	uint8_t header[STORAGE_HEADER_SIZE];
+	uint8_t sequence = 0;
+	uint16_t address, crc;
+	int slot;
+
+	if (!area || (size > area->maxSize))
+		return STORAGE_FAILED;
+	slot = storage_current_slot(area, size, &sequence);
+	slot = (slot + 1) % area->slots; // write over the oldest one
+	address = area->offset + slot * STORAGE_SLOT_SIZE(area);
+
+	header[0] = STORAGE_MAGIC;
+	header[1] = key;
+	header[2] = size;
+	header[3] = sequence + 1;
+	crc = storage_crc16(header, STORAGE_HEADER_SIZE);
+	crc = storage_crc16((const uint8_t *)data, size, crc);
+
+	for (uint8_t i = 0; i < STORAGE_HEADER_SIZE; i++)
+		storage_write_byte(address + i, header[i]);
+	for (uint8_t i = 0; i < size; i++)
+		storage_write_byte(address + STORAGE_HEADER_SIZE + i, ((const uint8_t *)data)[i]);
+	storage_write_byte(address + STORAGE_HEADER_SIZE + size, crc & 0xFF);
+	storage_write_byte(address + STORAGE_HEADER_SIZE + size + 1, crc >> 8);
+
+	return (storage_check_slot(address, key, size) == header[3]) ? STORAGE_SAVED : STORAGE_FAILED;
+}
+
+void storage_idle()
+{
+	// EEPROM writes need no compaction
+}
+#endif
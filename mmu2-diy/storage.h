@@ -0,0 +1,42 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+
+/*************************/
+// Persistent records (EEPROM on the AVR build, a flash key/value store on the
+// SKR mini, see flashkv.h)
+//
+// On EEPROM every record has a fixed area holding a ring of slots (two, more
+// for the records written often). A slot is
+//   magic | key | size | sequence | data | crc16
+// storage_save() always writes the slot after the current one, with the next
+// sequence number, so a write cut short by a reset leaves the previous record
+// in place: the commit is the last byte of the crc. storage_load() returns the
+// valid slot with the newest sequence number.
+//
+// On flash a save can also be queued: the page is full and the record waits in
+// RAM for the compaction of storage_idle(). Until then a reset loses it.
+/*************************/
+
+// record keys
+#define STORAGE_KEY_CALIBRATION 1
+#define STORAGE_KEY_MECHANICAL 2
+#define STORAGE_KEY_STATS 3
+#define STORAGE_KEY_JOURNAL 4
+
+bool storage_load(uint8_t key, void *data, uint8_t size);
+
+// storage_save() results
+#define STORAGE_FAILED 0
+#define STORAGE_SAVED 1
+#define STORAGE_QUEUED 2 // not stored yet, written by storage_idle()
+
+uint8_t storage_save(uint8_t key, const void *data, uint8_t size);
+
+// call when the MMU is idle: flash compaction and queued saves
+void storage_idle();
+
+uint16_t storage_crc16(const uint8_t *data, uint16_t length, uint16_t crc = 0xFFFF);
+
+#endif // STORAGE_H
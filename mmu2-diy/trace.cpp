@@ -0,0 +1,80 @@
+#include "trace.h"
+
+#ifdef EVENT_TRACE
+#include "print.h"
+
+#if (TRACE_SIZE & (TRACE_SIZE - 1)) != 0
+#error "TRACE_SIZE must be a power of two"
+#endif
+
+struct TraceEntry
+{
+	uint32_t us;
+	uint8_t event;
+	uint8_t arg;
+};
+
+static TraceEntry traceRing[TRACE_SIZE];
+static volatile uint32_t traceCount = 0; // events recorded since the last clear
+static uint8_t traceLevels[TRACE_EVENTS - TRACE_FIRST_LEVEL];
+static bool traceLevelsKnown = false;
+
+void trace_event(uint8_t event, uint8_t arg)
+{
+	uint32_t count = traceCount;
+	TraceEntry *entry = &traceRing[count & (TRACE_SIZE - 1)];
+
+	entry->us = micros();
+	entry->event = event;
+	entry->arg = arg;
+	traceCount = count + 1; // publish
+}
+
+void trace_level(uint8_t event, uint8_t level)
+{
+	uint8_t *last;
+
+	if ((event < TRACE_FIRST_LEVEL) || (event >= TRACE_EVENTS))
+		return;
+	if (!traceLevelsKnown)
+	{
+		memset(traceLevels, 0xFF, sizeof(traceLevels));
+		traceLevelsKnown = true;
+	}
+	last = &traceLevels[event - TRACE_FIRST_LEVEL];
+	if (*last == level)
+		return;
+	*last = level;
+	trace_event(event, level);
+}
+
+void trace_dump()
+{
+	uint32_t end = traceCount;
+	uint32_t first = (end > TRACE_SIZE) ? end - TRACE_SIZE : 0;
+	uint32_t lost = 0;
+	TraceEntry entry;
+
+	LOG_INFO("E BEGIN %lu %lu", (unsigned long)(end - first), (unsigned long)first);
+	for (uint32_t i = first; i < end; i++)
+	{
+		entry = traceRing[i & (TRACE_SIZE - 1)];
+		if (traceCount - i > TRACE_SIZE)
+		{
+			lost++; // overwritten while it was copied
+			continue;
+		}
+		LOG_INFO("E %lu %u %u", (unsigned long)entry.us, entry.event, entry.arg);
+		log_flush();
+	}
+	LOG_INFO("E END %lu", (unsigned long)lost);
+	log_flush();
+}
+
+void trace_clear()
+{
+	traceCount = 0;
+	traceLevelsKnown = false; // the next level of each input is recorded again
+}
+
+#endif // EVENT_TRACE
@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/*************************/
+// Event trace
+//
+// Optional (EVENT_TRACE in config.h): a ring of the last TRACE_SIZE events, each
+// with its micros() time stamp, kept in RAM and dumped with the 'E' console
+// command. buildroot/share/scripts/mmu_trace.py turns a dump into a Chrome /
+// Perfetto trace (chrome://tracing, ui.perfetto.dev).
+//
+// Recording never waits and never masks interrupts: the entry is written first,
+// then published by bumping the event count. The dump copies an entry and drops
+// it if the count has moved a whole ring past it in the meantime.
+//
+// Without EVENT_TRACE the TRACE_xxx() macros compile to nothing.
+/*************************/
+
+// events, arg in brackets
+#define TRACE_COMMAND 0		  // printer command received (command letter)
+#define TRACE_ACK 1			  // "ok" sent (command letter)
+#define TRACE_PHASE_BEGIN 2	  // tool change / C phase entered (STATS_PHASE_xxx)
+#define TRACE_PHASE_END 3	  // phase done (STATS_PHASE_xxx)
+#define TRACE_PROBLEM 4		  // fixTheProblem() entered (STATS_FAIL_xxx)
+#define TRACE_PROBLEM_END 5	  // operator answered, motion resumes (STATS_FAIL_xxx)
+#define TRACE_FINDA 6		  // FINDA edge (new level)
+#define TRACE_SWITCH 7		  // extruder filament switch edge (1: filament)
+#define TRACE_MOTOR_IDLER 8	  // idler driver enabled (1) / disabled (0)
+#define TRACE_MOTOR_SELECTOR 9 // selector driver
+#define TRACE_MOTOR_EXTRUDER 10 // extruder driver
+#define TRACE_EVENTS 11
+
+// events 6 and up are levels: only the changes are recorded
+#define TRACE_FIRST_LEVEL TRACE_FINDA
+
+// number of events kept, a power of two
+#ifndef TRACE_SIZE
+#ifdef __AVR__
+#define TRACE_SIZE 64
+#else
+#define TRACE_SIZE 512
+#endif
+#endif
+
+#ifdef EVENT_TRACE
+
+void trace_event(uint8_t event, uint8_t arg);
+
+// level events: recorded when the level differs from the last one recorded
+void trace_level(uint8_t event, uint8_t level);
+
+// 'E' console command: one "E <us> <event> <arg>" line per event, oldest first
+void trace_dump();
+
+void trace_clear();
+
+#define TRACE_EVENT(event, arg) trace_event(event, arg)
+#define TRACE_LEVEL(event, level) trace_level(event, level)
+#else
+#define TRACE_EVENT(event, arg) do {} while (0)
+#define TRACE_LEVEL(event, level) do {} while (0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,398 @@
+#include "mmu_model.h"
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+
+#define TIP_MIN -1000.0	 // mm, the whole filament is back on the spool
+#define PAST_GEAR 100.0	 // mm, the tip reaches the nozzle
+
+struct ModelParam
+{
+	const char *name;
+	size_t offset; // in ModelParams
+	const char *help;
+};
+
+#define PARAM(name, field, help) {name, offsetof(ModelParams, field), help}
+
+static const ModelParam modelParams[] = {
+	PARAM("finda", findaAt, "mm, FINDA trigger point"),
+	PARAM("entry", selectorEntry, "mm, filament enters the selector"),
+	PARAM("bowden", bowden, "mm, FINDA to the extruder gears"),
+	PARAM("switch", switchBeforeGear, "mm, filament switch before the gears"),
+	PARAM("eject", printerEject, "mm before the gears, tip after the printer unloads"),
+	PARAM("endstop", selectorEndstop, "full steps, selector endstop"),
+	PARAM("travel", selectorTravel, "full steps, selector right hard stop"),
+	PARAM("cs0", selectorSlot[0], "full steps, selector slot 0"),
+	PARAM("cs1", selectorSlot[1], "full steps, selector slot 1"),
+	PARAM("cs2", selectorSlot[2], "full steps, selector slot 2"),
+	PARAM("cs3", selectorSlot[3], "full steps, selector slot 3"),
+	PARAM("cs4", selectorSlot[4], "full steps, selector slot 4"),
+	PARAM("cstol", selectorTolerance, "full steps, selector misalignment that lets the filament through"),
+	PARAM("idler0", idlerSlot[0], "full steps, idler slot 0"),
+	PARAM("idler1", idlerSlot[1], "full steps, idler slot 1"),
+	PARAM("idler2", idlerSlot[2], "full steps, idler slot 2"),
+	PARAM("idler3", idlerSlot[3], "full steps, idler slot 3"),
+	PARAM("idler4", idlerSlot[4], "full steps, idler slot 4"),
+	PARAM("idlertravel", idlerTravel, "full steps, idler hard stop"),
+	PARAM("idlertol", idlerTolerance, "full steps, idler misalignment that still grips"),
+	PARAM("stall_idler", stallUs[MODEL_AXIS_IDLER], "us, shortest idler step interval"),
+	PARAM("stall_selector", stallUs[MODEL_AXIS_SELECTOR], "us, shortest selector step interval"),
+	PARAM("stall_extruder", stallUs[MODEL_AXIS_EXTRUDER], "us, shortest extruder step interval"),
+	PARAM("step_high", stepHighNs, "ns, driver minimum step high time"),
+	PARAM("step_low", stepLowNs, "ns, driver minimum step low time"),
+	PARAM("dir_setup", dirSetupNs, "ns, driver dir setup before the step edge"),
+	PARAM("dir_hold", dirHoldNs, "ns, driver dir hold after the step edge"),
+};
+
+MmuModel::MmuModel()
+{
+	params.findaAt = UNLOAD_LENGTH_BACK_COLORSELECTOR; // an unload parks the tip at 0
+	params.selectorEntry = 20;
+	params.bowden = 700;
+	params.switchBeforeGear = 5;
+	params.printerEject = 10;
+	params.selectorEndstop = CSSTEPS * 4 + 60;
+	params.selectorTravel = CSSTEPS * 4 + 100;
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+	{
+		params.selectorSlot[i] = CSSTEPS * i + CSOFFSET[i];
+		params.idlerSlot[i] = IDLERSTEPSIZE * i + IDLEROFFSET[i];
+	}
+	params.selectorTolerance = 20;
+	params.idlerTravel = MAXROLLERTRAVEL + 5;
+	params.idlerTolerance = 5;
+	params.stallUs[MODEL_AXIS_IDLER] = 200;
+	params.stallUs[MODEL_AXIS_SELECTOR] = 40;
+	params.stallUs[MODEL_AXIS_EXTRUDER] = 40;
+	params.stepHighNs = 1900; // DRV8825
+	params.stepLowNs = 1900;
+	params.dirSetupNs = 650;
+	params.dirHoldNs = 650;
+
+	memset(&counters, 0, sizeof(counters));
+	for (uint8_t i = 0; i < MODEL_AXES; i++)
+	{
+		counters.minIntervalUs[i] = HUGE_VAL;
+		lastStep[i] = 0;
+		stepped[i] = false;
+	}
+	counters.selectorMargin = HUGE_VAL;
+	counters.idlerMargin = HUGE_VAL;
+	faults.findaStuck = -1;
+	faults.slip = 0;
+	faults.selectorLoss = 0;
+	faults.switchBounce = 0;
+	randomState = 1;
+
+	memset(levels, LOW, sizeof(levels));
+	memset(modes, INPUT, sizeof(modes));
+	selectorSteps = (int64_t)(params.selectorSlot[0] * STEPSIZE);
+	idlerSteps = (int64_t)MAXROLLERTRAVEL * STEPSIZE; // parked
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+		tipSteps[i] = 0;
+}
+
+bool MmuModel::set(const char *name, double value)
+{
+	for (size_t i = 0; i < sizeof(modelParams) / sizeof(modelParams[0]); i++)
+	{
+		if (strcmp(name, modelParams[i].name) == 0)
+		{
+			*(double *)((char *)&params + modelParams[i].offset) = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+void MmuModel::listParams(FILE *out)
+{
+	for (size_t i = 0; i < sizeof(modelParams) / sizeof(modelParams[0]); i++)
+	{
+		fprintf(out, "  %-15s %10.2f  %s\n", modelParams[i].name,
+				*(const double *)((const char *)&params + modelParams[i].offset), modelParams[i].help);
+	}
+}
+
+/*************************/
+// Pins
+/*************************/
+void MmuModel::pinMode(uint8_t pin, uint8_t mode)
+{
+	if (pin < HAL_PIN_COUNT)
+		modes[pin] = mode;
+}
+
+void MmuModel::write(uint8_t pin, uint8_t level, uint64_t now)
+{
+	bool rising;
+
+	if (pin >= HAL_PIN_COUNT)
+		return;
+	rising = level && !levels[pin];
+	levels[pin] = level ? HIGH : LOW;
+	if (!rising)
+		return;
+
+	if ((pin == idlerStepPin) && (levels[idlerEnablePin] == ENABLE) && stepAllowed(MODEL_AXIS_IDLER, now))
+		stepIdler(levels[idlerDirPin] ? 1 : -1); // CW (LOW) towards the hard stop
+	else if ((pin == colorSelectorStepPin) && (levels[colorSelectorEnablePin] == ENABLE) && stepAllowed(MODEL_AXIS_SELECTOR, now))
+		stepSelector(levels[colorSelectorDirPin] ? -1 : 1); // CW (LOW) towards the endstop
+	else if ((pin == extruderStepPin) && (levels[extruderEnablePin] == ENABLE) && stepAllowed(MODEL_AXIS_EXTRUDER, now))
+		stepExtruder(levels[extruderDirPin] ? 1 : -1); // CCW (HIGH) towards the printer
+}
+
+int MmuModel::read(uint8_t pin)
+{
+	if (pin == findaPin)
+	{
+		if (faults.findaStuck >= 0)
+			return faults.findaStuck ? HIGH : LOW;
+		return findaActive() ? HIGH : LOW;
+	}
+	if (pin == filamentSwitch)
+	{
+		bool active = switchActive();
+
+		if (draw(faults.switchBounce))
+			active = !active;
+		return active ? filamentSwitchON : !filamentSwitchON;
+	}
+	if (pin == colorSelectorEnstop)
+		return endstopActive() ? LOW : HIGH; // switch to ground, pull-up
+	if (pin >= HAL_PIN_COUNT)
+		return LOW;
+	if ((modes[pin] == INPUT_PULLUP) && !levels[pin])
+		return HIGH;
+	return levels[pin];
+}
+
+/*************************/
+// Motors
+/*************************/
+bool MmuModel::stepAllowed(uint8_t axis, uint64_t now)
+{
+	double interval = (now - lastStep[axis]) / 1000.0;
+	bool first = !stepped[axis];
+
+	stepped[axis] = true;
+	lastStep[axis] = now;
+	counters.steps[axis]++;
+	if (first)
+		return true;
+	if (interval < counters.minIntervalUs[axis])
+		counters.minIntervalUs[axis] = interval;
+	if (interval < params.stallUs[axis])
+	{
+		counters.lost[axis]++;
+		return false;
+	}
+	return true;
+}
+
+void MmuModel::stepIdler(int direction)
+{
+	int64_t next = idlerSteps + direction;
+
+	if ((next < 0) || (next > (int64_t)(params.idlerTravel * STEPSIZE)))
+	{
+		counters.lost[MODEL_AXIS_IDLER]++;
+		return;
+	}
+	idlerSteps = next;
+}
+
+void MmuModel::stepSelector(int direction)
+{
+	int64_t next = selectorSteps + direction;
+
+	if ((next < 0) || (next > (int64_t)(params.selectorTravel * STEPSIZE)))
+	{
+		counters.lost[MODEL_AXIS_SELECTOR]++;
+		return;
+	}
+	if (draw(faults.selectorLoss))
+	{
+		counters.lost[MODEL_AXIS_SELECTOR]++;
+		return;
+	}
+	// a filament in the selector holds it in front of its slot
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+	{
+		double before = fabs(selectorSteps / (double)STEPSIZE - params.selectorSlot[i]);
+		double after = fabs(next / (double)STEPSIZE - params.selectorSlot[i]);
+
+		if ((tip(i) > params.selectorEntry) && (after > params.selectorTolerance) && (after > before))
+		{
+			counters.lost[MODEL_AXIS_SELECTOR]++;
+			return;
+		}
+	}
+	selectorSteps = next;
+}
+
+void MmuModel::stepExtruder(int direction)
+{
+	int slot = engagedSlot();
+	int64_t entry = (int64_t)(params.selectorEntry * STEPSPERMM);
+	int64_t next;
+	double margin;
+
+	if (slot < 0)
+	{
+		counters.slips++;
+		return;
+	}
+	if (draw(faults.slip))
+		return; // the gear turns, the filament does not move
+	margin = params.idlerTolerance - fabs(idlerPosition() - params.idlerSlot[slot]);
+	if (margin < counters.idlerMargin)
+		counters.idlerMargin = margin;
+
+	next = tipSteps[slot] + direction;
+	if ((next < (int64_t)(TIP_MIN * STEPSPERMM)) || (next > (int64_t)((gearAt() + PAST_GEAR) * STEPSPERMM)))
+	{
+		counters.slips++;
+		return;
+	}
+	if ((tipSteps[slot] <= entry) && (next > entry))
+	{
+		margin = params.selectorTolerance - fabs(selectorPosition() - params.selectorSlot[slot]);
+		if (margin < 0)
+		{
+			counters.jams++;
+			return;
+		}
+		if (margin < counters.selectorMargin)
+			counters.selectorMargin = margin;
+	}
+	tipSteps[slot] = next;
+}
+
+bool MmuModel::draw(double probability)
+{
+	if (probability <= 0)
+		return false;
+	// xorshift32
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	if (randomState / 4294967296.0 >= probability)
+		return false;
+	counters.faulted++;
+	return true;
+}
+
+void MmuModel::seed(uint32_t value)
+{
+	randomState = value ? value : 1;
+}
+
+/*************************/
+// State
+/*************************/
+double MmuModel::gearAt()
+{
+	return params.findaAt + params.bowden;
+}
+
+void MmuModel::printerUnload()
+{
+	double limit = gearAt() - params.printerEject;
+
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+	{
+		if (tip(i) > limit)
+			setTip(i, limit);
+	}
+}
+
+double MmuModel::tip(uint8_t slot)
+{
+	return tipSteps[slot] / (double)STEPSPERMM;
+}
+
+void MmuModel::setTip(uint8_t slot, double mm)
+{
+	tipSteps[slot] = (int64_t)llround(mm * STEPSPERMM);
+}
+
+double MmuModel::selectorPosition()
+{
+	return selectorSteps / (double)STEPSIZE;
+}
+
+double MmuModel::idlerPosition()
+{
+	return idlerSteps / (double)STEPSIZE;
+}
+
+int MmuModel::engagedSlot()
+{
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+	{
+		if (fabs(idlerPosition() - params.idlerSlot[i]) <= params.idlerTolerance)
+			return i;
+	}
+	return -1;
+}
+
+bool MmuModel::findaActive()
+{
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+	{
+		if (tip(i) >= params.findaAt)
+			return true;
+	}
+	return false;
+}
+
+bool MmuModel::switchActive()
+{
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+	{
+		if (tip(i) >= gearAt() - params.switchBeforeGear)
+			return true;
+	}
+	return false;
+}
+
+bool MmuModel::endstopActive()
+{
+	return selectorPosition() >= params.selectorEndstop;
+}
+
+bool MmuModel::load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	long long value;
+	char name[16];
+
+	if (!f)
+		return false;
+	while (fscanf(f, "%15[^=]=%lld\n", name, &value) == 2)
+	{
+		if (strcmp(name, "selector") == 0)
+			selectorSteps = value;
+		else if (strcmp(name, "idler") == 0)
+			idlerSteps = value;
+		else if ((strncmp(name, "tip", 3) == 0) && (name[3] >= '0') && (name[3] < '0' + MODEL_SLOTS))
+			tipSteps[name[3] - '0'] = value;
+	}
+	fclose(f);
+	return true;
+}
+
+bool MmuModel::save(const char *path)
+{
+	FILE *f = fopen(path, "w");
+
+	if (!f)
+		return false;
+	fprintf(f, "selector=%lld\nidler=%lld\n", (long long)selectorSteps, (long long)idlerSteps);
+	for (uint8_t i = 0; i < MODEL_SLOTS; i++)
+		fprintf(f, "tip%d=%lld\n", i, (long long)tipSteps[i]);
+	fclose(f);
+	return true;
+}
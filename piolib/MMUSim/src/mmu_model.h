@@ -0,0 +1,135 @@
+#ifndef MMU_MODEL_H
+#define MMU_MODEL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <hal.h>
+
+/*************************/
+// Mechanical model of the MMU filament path
+//
+// Driven by the step / dir / enable pins of config.h, it keeps:
+// - the selector carriage on its lead screw: hard stop on the left, endstop switch
+//   on the right, it moves the filament opening in front of one of the five slots
+// - the idler cam: hard stop at 0, a slot is pressed against the drive gear when the
+//   cam is within idlerTolerance of the slot's bearing
+// - the tip of each of the five filaments, in mm from its parked position behind the
+//   selector (negative: pulled back towards the spool)
+// and computes the FINDA, filament switch and endstop inputs from them.
+//
+// Idler and selector positions are in full steps, like the firmware's tables; the
+// filament moves 1 / STEPSPERMM mm per extruder step.
+// A step closer to the previous one of the same motor than its stall interval is lost.
+// The filament cannot go past selectorEntry unless the selector is in front of its
+// slot (jam), and the selector cannot leave a slot whose filament is in it.
+//
+// faults alter the machine while they are set (the simulator sets them for the
+// time window of a --fault): a FINDA stuck at a level, extruder steps that do not
+// move the filament (slip), selector steps lost, filament switch reads that are
+// wrong (bounce). The random draws come from seed().
+/*************************/
+
+#define MODEL_SLOTS 5
+#define MODEL_AXES 3 // same order as STATS_AXIS_xxx
+
+#define MODEL_AXIS_IDLER 0
+#define MODEL_AXIS_SELECTOR 1
+#define MODEL_AXIS_EXTRUDER 2
+
+struct ModelParams
+{
+	double findaAt;					 // mm, FINDA trigger point
+	double selectorEntry;			 // mm, the filament enters the selector
+	double bowden;					 // mm, from the FINDA to the extruder gears
+	double switchBeforeGear;		 // mm, filament switch trigger point before the gears
+	double printerEject;			 // mm before the gears, where the printer leaves the tip when it unloads
+	double selectorEndstop;			 // full steps
+	double selectorTravel;			 // full steps, right hard stop
+	double selectorSlot[MODEL_SLOTS]; // full steps
+	double selectorTolerance;		 // full steps, misalignment that still lets the filament through
+	double idlerSlot[MODEL_SLOTS];	 // full steps
+	double idlerTravel;				 // full steps
+	double idlerTolerance;			 // full steps, misalignment that still grips the filament
+	double stallUs[MODEL_AXES];		 // shortest step interval each motor follows
+	double stepHighNs;				 // driver limits (see PinTrace)
+	double stepLowNs;
+	double dirSetupNs;
+	double dirHoldNs;
+};
+
+struct ModelCounters
+{
+	uint32_t steps[MODEL_AXES];		 // steps taken
+	uint32_t lost[MODEL_AXES];		 // steps lost: stall, hard stop, blocked
+	uint32_t slips;					 // extruder steps with no filament gripped
+	uint32_t jams;					 // extruder steps blocked at the selector entry
+	double minIntervalUs[MODEL_AXES]; // shortest step interval seen
+	uint32_t faulted;				 // steps and reads altered by a fault
+	double selectorMargin;			 // smallest tolerance left when a filament entered the selector (full steps)
+	double idlerMargin;				 // smallest tolerance left while the filament was driven (full steps)
+};
+
+struct ModelFaults
+{
+	int8_t findaStuck;	 // -1: none, else the level the FINDA reads (1: filament)
+	double slip;		 // fraction of the extruder steps that do not move the filament
+	double selectorLoss; // fraction of the selector steps lost
+	double switchBounce; // probability that a filament switch read is wrong
+};
+
+class MmuModel
+{
+public:
+	MmuModel();
+
+	// set a parameter by name (see the table in mmu_model.cpp), false if unknown
+	bool set(const char *name, double value);
+	void listParams(FILE *out);
+
+	// pins, time in ns
+	void pinMode(uint8_t pin, uint8_t mode);
+	void write(uint8_t pin, uint8_t level, uint64_t now);
+	int read(uint8_t pin);
+
+	// the printer pulls the filament out of its extruder before a T or U
+	void printerUnload();
+
+	double tip(uint8_t slot);
+	void setTip(uint8_t slot, double mm);
+	double selectorPosition();
+	double idlerPosition();
+	int engagedSlot();
+	bool findaActive();
+	bool switchActive();
+	bool endstopActive();
+
+	// state file (positions), for a warm boot in the next run
+	bool load(const char *path);
+	bool save(const char *path);
+
+	void seed(uint32_t value);
+	// true with the given probability, counted in counters.faulted
+	bool draw(double probability);
+
+	ModelParams params;
+	ModelCounters counters;
+	ModelFaults faults;
+
+private:
+	bool stepAllowed(uint8_t axis, uint64_t now);
+	void stepIdler(int direction);
+	void stepSelector(int direction);
+	void stepExtruder(int direction);
+	double gearAt();
+
+	uint8_t levels[HAL_PIN_COUNT];
+	uint8_t modes[HAL_PIN_COUNT];
+	int64_t selectorSteps; // microsteps
+	int64_t idlerSteps;	   // microsteps
+	int64_t tipSteps[MODEL_SLOTS];
+	uint64_t lastStep[MODEL_AXES];
+	bool stepped[MODEL_AXES];
+	uint32_t randomState;
+};
+
+#endif // MMU_MODEL_H
@@ -0,0 +1,67 @@
+#include "model_host.h"
+#include <Arduino.h>
+#include <signal.h>
+
+ModelHostBackend::ModelHostBackend(MmuModel &model) : model(model), lineStart(true)
+{
+}
+
+void ModelHostBackend::pinMode(uint8_t pin, uint8_t mode)
+{
+	model.pinMode(pin, mode);
+}
+
+void ModelHostBackend::digitalWrite(uint8_t pin, uint8_t value)
+{
+	model.write(pin, value, micros() * 1000);
+}
+
+int ModelHostBackend::digitalRead(uint8_t pin)
+{
+	return model.read(pin);
+}
+
+int ModelHostBackend::uartRead(uint8_t port)
+{
+	int c = HostBackend::uartRead(port);
+
+	if ((port != 1) || (c < 0))
+		return c;
+	if (lineStart && ((c == 'T') || (c == 'U')))
+		model.printerUnload();
+	lineStart = (c == '\n');
+	return c;
+}
+
+#ifdef MMU_HOST_MODEL
+/*************************/
+// native-model: the firmware in real time against the model
+//   MMU_MODEL_STATE=<file> keeps the model positions between runs, like
+//   MMU_EEPROM does for the firmware (saved on SIGINT / SIGTERM)
+/*************************/
+static MmuModel model;
+static ModelHostBackend backend(model);
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+	stopRequested = 1;
+}
+
+int main()
+{
+	const char *statePath = getenv("MMU_MODEL_STATE");
+
+	if (statePath)
+		model.load(statePath);
+	signal(SIGINT, requestStop);
+	signal(SIGTERM, requestStop);
+	hal_set_backend(&backend);
+	setup();
+	while (!stopRequested)
+		loop();
+	if (statePath)
+		model.save(statePath);
+	return 0;
+}
+#endif // MMU_HOST_MODEL
@@ -0,0 +1,35 @@
+#ifndef MODEL_HOST_H
+#define MODEL_HOST_H
+
+#include <host_backend.h>
+#include "mmu_model.h"
+
+/*************************/
+// Real time backend with the MMU model on the pins
+//
+// Like HostBackend (wall clock, Serial on the terminal, Serial1 on MMU_SERIAL1),
+// but the pins go to an MmuModel, so that the FINDA and the filament switch
+// follow the motors and the motion commands complete. Used by the native-model
+// build, the firmware then talks to a printer stand-in over a pty, see
+// buildroot/share/scripts/mmu_host.py.
+//
+// The printer unloads its own extruder before it sends a T or a U: the model
+// does it when the firmware reads one of these at the start of a line.
+/*************************/
+
+class ModelHostBackend : public HostBackend
+{
+public:
+	explicit ModelHostBackend(MmuModel &model);
+
+	void pinMode(uint8_t pin, uint8_t mode) override;
+	void digitalWrite(uint8_t pin, uint8_t value) override;
+	int digitalRead(uint8_t pin) override;
+	int uartRead(uint8_t port) override;
+
+private:
+	MmuModel &model;
+	bool lineStart;
+};
+
+#endif // MODEL_HOST_H
@@ -0,0 +1,169 @@
+#include "pin_trace.h"
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+
+#define ROLE_STEP 0
+#define ROLE_DIR 1
+#define ROLE_ENABLE 2
+#define ROLE_INPUT 3
+
+struct TraceSignal
+{
+	uint8_t pin;
+	const char *name;
+	uint8_t axis;
+	uint8_t role;
+};
+
+#define SIGNAL(pin, axis, role) {pin, #pin, axis, role}
+
+static const TraceSignal traceSignals[] = {
+	SIGNAL(idlerStepPin, MODEL_AXIS_IDLER, ROLE_STEP),
+	SIGNAL(idlerDirPin, MODEL_AXIS_IDLER, ROLE_DIR),
+	SIGNAL(idlerEnablePin, MODEL_AXIS_IDLER, ROLE_ENABLE),
+	SIGNAL(colorSelectorStepPin, MODEL_AXIS_SELECTOR, ROLE_STEP),
+	SIGNAL(colorSelectorDirPin, MODEL_AXIS_SELECTOR, ROLE_DIR),
+	SIGNAL(colorSelectorEnablePin, MODEL_AXIS_SELECTOR, ROLE_ENABLE),
+	SIGNAL(extruderStepPin, MODEL_AXIS_EXTRUDER, ROLE_STEP),
+	SIGNAL(extruderDirPin, MODEL_AXIS_EXTRUDER, ROLE_DIR),
+	SIGNAL(extruderEnablePin, MODEL_AXIS_EXTRUDER, ROLE_ENABLE),
+	SIGNAL(findaPin, 0, ROLE_INPUT),
+	SIGNAL(filamentSwitch, 0, ROLE_INPUT),
+	SIGNAL(colorSelectorEnstop, 0, ROLE_INPUT),
+	SIGNAL(greenLED, 0, ROLE_INPUT),
+};
+
+#define TRACE_SIGNALS (sizeof(traceSignals) / sizeof(traceSignals[0]))
+
+PinTrace::PinTrace(MmuModel &model) : model(model), vcd(NULL), vcdFrom(0), vcdTo(0), vcdStarted(false), vcdLast(0), sampled(false)
+{
+	for (uint8_t i = 0; i < MODEL_AXES; i++)
+	{
+		timing[i].highNs = HUGE_VAL;
+		timing[i].lowNs = HUGE_VAL;
+		timing[i].dirSetupNs = HUGE_VAL;
+		timing[i].dirHoldNs = HUGE_VAL;
+		timing[i].violations = 0;
+		timing[i].disabled = 0;
+		stepRise[i] = 0;
+		stepFall[i] = 0;
+		dirChange[i] = 0;
+		stepSeen[i] = false;
+	}
+}
+
+/*************************/
+// Value Change Dump
+/*************************/
+bool PinTrace::openVcd(const char *path, uint64_t from, uint64_t to)
+{
+	vcd = fopen(path, "w");
+	if (!vcd)
+		return false;
+	vcdFrom = from;
+	vcdTo = to;
+	fprintf(vcd, "$version mmu-sim $end\n$timescale 1ns $end\n$scope module mmu $end\n");
+	for (uint8_t i = 0; i < TRACE_SIGNALS; i++)
+		fprintf(vcd, "$var wire 1 %c %s $end\n", '!' + i, traceSignals[i].name);
+	fprintf(vcd, "$upscope $end\n$enddefinitions $end\n");
+	return true;
+}
+
+void PinTrace::closeVcd()
+{
+	if (vcd)
+		fclose(vcd);
+	vcd = NULL;
+}
+
+void PinTrace::dump(uint8_t signal, uint8_t level, uint64_t now)
+{
+	if (!vcd || (now < vcdFrom) || (now > vcdTo))
+		return;
+	if (!vcdStarted)
+	{
+		// values at the start of the window
+		fprintf(vcd, "#%llu\n$dumpvars\n", (unsigned long long)now);
+		for (uint8_t i = 0; i < TRACE_SIGNALS; i++)
+			fprintf(vcd, "%d%c\n", levels[i], '!' + i);
+		fprintf(vcd, "$end\n");
+		vcdStarted = true;
+		vcdLast = now;
+		return;
+	}
+	if (now != vcdLast)
+		fprintf(vcd, "#%llu\n", (unsigned long long)now);
+	vcdLast = now;
+	fprintf(vcd, "%d%c\n", level, '!' + signal);
+}
+
+/*************************/
+// Driver limits
+/*************************/
+void PinTrace::checkStep(uint8_t axis, uint8_t signal, uint8_t level, uint64_t now)
+{
+	StepTiming &t = timing[axis];
+	const ModelParams &p = model.params;
+	double ns;
+
+	if (traceSignals[signal].role == ROLE_DIR)
+	{
+		if (stepSeen[axis])
+		{
+			ns = (double)(now - stepRise[axis]);
+			t.dirHoldNs = fmin(t.dirHoldNs, ns);
+			if (ns < p.dirHoldNs)
+				t.violations++;
+		}
+		dirChange[axis] = now;
+		return;
+	}
+	if (traceSignals[signal].role != ROLE_STEP)
+		return;
+
+	if (!level)
+	{
+		ns = (double)(now - stepRise[axis]);
+		t.highNs = fmin(t.highNs, ns);
+		if (ns < p.stepHighNs)
+			t.violations++;
+		stepFall[axis] = now;
+		return;
+	}
+	if (stepSeen[axis])
+	{
+		ns = (double)(now - stepFall[axis]);
+		t.lowNs = fmin(t.lowNs, ns);
+		if (ns < p.stepLowNs)
+			t.violations++;
+	}
+	if (dirChange[axis] > stepRise[axis])
+	{
+		ns = (double)(now - dirChange[axis]);
+		t.dirSetupNs = fmin(t.dirSetupNs, ns);
+		if (ns < p.dirSetupNs)
+			t.violations++;
+	}
+	if (levels[signal + 2] != ENABLE) // step, dir, enable in the table
+		t.disabled++;
+	stepRise[axis] = now;
+	stepSeen[axis] = true;
+}
+
+void PinTrace::sample(uint64_t now)
+{
+	for (uint8_t i = 0; i < TRACE_SIGNALS; i++)
+	{
+		uint8_t level = model.read(traceSignals[i].pin) ? 1 : 0;
+
+		if (sampled && (level == levels[i]))
+			continue;
+		if (sampled && (traceSignals[i].role != ROLE_INPUT))
+			checkStep(traceSignals[i].axis, i, level, now);
+		levels[i] = level;
+		if (sampled)
+			dump(i, level, now);
+	}
+	sampled = true;
+}
@@ -0,0 +1,62 @@
+#ifndef PIN_TRACE_H
+#define PIN_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "mmu_model.h"
+
+/*************************/
+// Pin transitions of the config.h pins, in virtual time
+//
+// sample() is called after every pin write and simulator event: it reads the
+// step / dir / enable outputs, the FINDA, filament switch, endstop and LED pins
+// through the model and handles the ones that changed:
+// - written to a Value Change Dump (GTKWave), if one is open
+// - step pulses checked against the driver limits of the model (step_high,
+//   step_low, dir_setup, dir_hold, see --params): shortest value seen per motor
+//   and the number of pulses that broke a limit, including the steps sent while
+//   the driver was disabled (ignored by the driver)
+/*************************/
+
+struct StepTiming
+{
+	double highNs;		// shortest step high time
+	double lowNs;		// shortest step low time
+	double dirSetupNs;	// shortest dir change to rising step edge
+	double dirHoldNs;	// shortest rising step edge to dir change
+	uint32_t violations; // pulses breaking one of the driver limits
+	uint32_t disabled;	// steps while the driver was disabled
+};
+
+class PinTrace
+{
+public:
+	explicit PinTrace(MmuModel &model);
+
+	// write the transitions between from and to (ns) to path
+	bool openVcd(const char *path, uint64_t from, uint64_t to);
+	void closeVcd();
+
+	void sample(uint64_t now);
+
+	StepTiming timing[MODEL_AXES];
+
+private:
+	void checkStep(uint8_t axis, uint8_t signal, uint8_t level, uint64_t now);
+	void dump(uint8_t signal, uint8_t level, uint64_t now);
+
+	MmuModel &model;
+	FILE *vcd;
+	uint64_t vcdFrom;
+	uint64_t vcdTo;
+	bool vcdStarted;
+	uint64_t vcdLast;
+	uint8_t levels[16];
+	bool sampled;
+	uint64_t stepRise[MODEL_AXES];
+	uint64_t stepFall[MODEL_AXES];
+	uint64_t dirChange[MODEL_AXES];
+	bool stepSeen[MODEL_AXES];
+};
+
+#endif // PIN_TRACE_H
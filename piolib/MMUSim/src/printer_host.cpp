@@ -0,0 +1,79 @@
+#include "printer_host.h"
+
+#define PRINTER_PORT 1
+
+PrinterHost::PrinterHost(SimBackend &sim, MmuModel &model)
+	: timeoutNs(600 * 1000000000ull), thinkNs(0), sim(sim), model(model), next(0), started(false), finished(false), timeout(false)
+{
+	sim.listen(PRINTER_PORT, [this](uint8_t c) { receive(c); });
+}
+
+void PrinterHost::script(const std::vector<std::string> &commands)
+{
+	pending.clear();
+	pending.push_back("S1");
+	pending.push_back("S2");
+	pending.push_back("P0");
+	pending.insert(pending.end(), commands.begin(), commands.end());
+	next = 0;
+}
+
+void PrinterHost::sendNext()
+{
+	CommandResult result;
+	size_t index = results.size();
+
+	if (next >= pending.size())
+	{
+		finished = true;
+		return;
+	}
+	result.command = pending[next++];
+	result.sentNs = sim.now();
+	result.ackNs = 0;
+	result.acked = false;
+	if ((result.command[0] == 'T') || (result.command[0] == 'U'))
+		model.printerUnload();
+	if (onSend)
+		onSend(result.command);
+	results.push_back(result);
+	sim.send(PRINTER_PORT, (result.command + "\n").c_str(), result.sentNs);
+
+	sim.at(result.sentNs + timeoutNs, [this, index]() {
+		if (!results[index].acked && !finished)
+		{
+			timeout = true;
+			finished = true;
+		}
+	});
+}
+
+void PrinterHost::receive(uint8_t c)
+{
+	if (c != '\n')
+	{
+		line += (char)c;
+		return;
+	}
+	if (!started)
+	{
+		// "start", possibly repeated until the printer answers
+		if (line == "start")
+		{
+			started = true;
+			sendNext();
+		}
+	}
+	else if ((line.size() >= 2) && (line.compare(line.size() - 2, 2, "ok") == 0) && !results.empty() && !results.back().acked)
+	{
+		CommandResult &result = results.back();
+
+		result.reply = line.substr(0, line.size() - 2);
+		result.ackNs = sim.now();
+		result.acked = true;
+		if (onAck)
+			onAck(result);
+		sim.at(sim.now() + thinkNs, [this]() { sendNext(); });
+	}
+	line.clear();
+}
@@ -0,0 +1,61 @@
+#ifndef PRINTER_HOST_H
+#define PRINTER_HOST_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "sim_backend.h"
+
+/*************************/
+// Printer side of Serial1
+//
+// Plays the MMU2 part of Marlin: answers "start" with the S1 / S2 / P0 handshake,
+// then sends the scripted commands one at a time, each one when the previous one
+// has been acknowledged ("ok"). Before a T or U the printer unloads its own
+// extruder (MmuModel::printerUnload()). A command that is not acknowledged within
+// timeoutNs ends the run.
+/*************************/
+
+struct CommandResult
+{
+	std::string command;
+	std::string reply; // what came before the "ok"
+	uint64_t sentNs;   // first byte on the wire
+	uint64_t ackNs;	   // "ok" fully received
+	bool acked;
+};
+
+class PrinterHost
+{
+public:
+	PrinterHost(SimBackend &sim, MmuModel &model);
+
+	void script(const std::vector<std::string> &commands);
+
+	// true when the script is finished or a command timed out
+	bool done() const { return finished; }
+	bool timedOut() const { return timeout; }
+
+	// called when a command is acknowledged, and when it is sent
+	std::function<void(const CommandResult &result)> onAck;
+	std::function<void(const std::string &command)> onSend;
+
+	std::vector<CommandResult> results;
+	uint64_t timeoutNs;
+	uint64_t thinkNs; // printer time between an ack and the next command
+
+private:
+	void receive(uint8_t c);
+	void sendNext();
+
+	SimBackend &sim;
+	MmuModel &model;
+	std::vector<std::string> pending;
+	size_t next;
+	std::string line;
+	bool started;
+	bool finished;
+	bool timeout;
+};
+
+#endif // PRINTER_HOST_H
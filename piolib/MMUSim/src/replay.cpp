@@ -0,0 +1,438 @@
+#include "replay.h"
+#include <Arduino.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include "config.h"
+#include "recorder.h"
+#include "storage.h"
+#include "application.h"
+
+Replay::Replay(SimBackend &sim) : lost(0), epochNs(0), tickNs(4000), sim(sim), armed(false)
+{
+	for (uint8_t i = 0; i < 3; i++)
+		current[i] = 0;
+}
+
+/*************************/
+// Capture
+/*************************/
+static int hexValue(char c)
+{
+	if ((c >= '0') && (c <= '9'))
+		return c - '0';
+	if ((c >= 'A') && (c <= 'F'))
+		return c - 'A' + 10;
+	if ((c >= 'a') && (c <= 'f'))
+		return c - 'a' + 10;
+	return -1;
+}
+
+static bool hexBytes(const char *text, std::vector<uint8_t> &bytes)
+{
+	bytes.clear();
+	for (; hexValue(text[0]) >= 0; text += 2)
+	{
+		if (hexValue(text[1]) < 0)
+			return false;
+		bytes.push_back(hexValue(text[0]) * 16 + hexValue(text[1]));
+	}
+	return (*text == 0) || (*text == '\r') || (*text == '\n');
+}
+
+bool Replay::load(const char *path, int boot, std::string &error)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+	int boots = 0;
+	uint64_t ticks = 0;
+	int64_t since = -1; // RECORDER_SINCE ticks for the next entry
+	unsigned number = 0;
+	std::vector<uint8_t> bytes;
+
+	if (!f)
+	{
+		error = std::string(path) + ": " + strerror(errno);
+		return false;
+	}
+	while (fgets(line, sizeof(line), f))
+	{
+		const char *text = line + strspn(line, " \t");
+
+		number++;
+		if (strncmp(text, "R ", 2))
+			continue; // the rest of the console
+		text += 2;
+		if (!strncmp(text, "BEGIN", 5))
+		{
+			if ((++boots == boot) && atoi(text + 5))
+				tickNs = atoi(text + 5) * 1000ull;
+			continue;
+		}
+		if (boots != boot)
+			continue;
+		if (!strncmp(text, "LOST ", 5))
+		{
+			lost = strtoul(text + 5, NULL, 10);
+			continue;
+		}
+		if (!strncmp(text, "S ", 2))
+		{
+			ReplayRecord record;
+			char *end;
+
+			record.key = strtoul(text + 2, &end, 10);
+			if ((*end != ' ') || !hexBytes(end + 1, record.data))
+			{
+				error = "bad record in line " + std::to_string(number);
+				fclose(f);
+				return false;
+			}
+			records.push_back(record);
+			continue;
+		}
+		if (!hexBytes(text, bytes) || (bytes.size() % 4))
+		{
+			error = "bad entries in line " + std::to_string(number);
+			fclose(f);
+			return false;
+		}
+		for (size_t i = 0; i < bytes.size(); i += 4)
+		{
+			ReplayEntry entry;
+
+			if (bytes[i + 2] == RECORDER_SINCE)
+			{
+				since = bytes[i] * 256 + bytes[i + 1]; // no time of its own
+				continue;
+			}
+			ticks += bytes[i] * 256 + bytes[i + 1];
+			if (bytes[i + 2] == RECORDER_GAP)
+			{
+				ticks += (uint64_t)bytes[i + 3] << 16;
+				continue;
+			}
+			entry.ns = ticks * tickNs;
+			entry.channel = bytes[i + 2];
+			// an entry is timed with the read that found its input, within a tick: the input
+			// is there from just after the previous read, from the start for bytes found
+			// by the first one, or for that read
+			if (since >= 0)
+				entry.fromNs = (ticks - std::min<uint64_t>(ticks, since + 1)) * tickNs + 1;
+			else if ((entry.channel == RECORDER_RX_SEEN) || (entry.channel == RECORDER_CONSOLE_SEEN))
+				entry.fromNs = 0;
+			else
+				entry.fromNs = entry.ns - std::min(entry.ns, tickNs);
+			since = -1;
+			entry.value = bytes[i + 3];
+			entries.push_back(entry);
+		}
+	}
+	fclose(f);
+	if (boots < boot)
+	{
+		error = "no boot " + std::to_string(boot) + " in the capture (R BEGIN), it has " + std::to_string(boots);
+		return false;
+	}
+	return true;
+}
+
+uint64_t Replay::endNs() const
+{
+	return entries.empty() ? 0 : entries.back().ns;
+}
+
+/*************************/
+// Inputs
+/*************************/
+int Replay::level(uint8_t channel, int modelLevel)
+{
+	std::vector<const ReplayEntry *> &edges = levels[channel - RECORDER_FINDA];
+	size_t &i = current[channel - RECORDER_FINDA];
+
+	if (edges.empty())
+		return modelLevel; // never read on the unit
+	while ((i + 1 < edges.size()) && (edges[i + 1]->fromNs + epochNs <= sim.now()))
+		i++;
+	return edges[i]->value; // before the first read: the level it found
+}
+
+void Replay::start()
+{
+	for (size_t i = 0; i < records.size(); i++)
+		storage_save(records[i].key, &records[i].data[0], records[i].data.size());
+	sim.pinInput = [this](uint8_t pin, int modelLevel) {
+		if (pin == findaPin)
+			return level(RECORDER_FINDA, modelLevel);
+		if (pin == filamentSwitch)
+			return level(RECORDER_SWITCH, modelLevel);
+		if (pin == colorSelectorEnstop)
+			return level(RECORDER_ENDSTOP, modelLevel);
+		return modelLevel;
+	};
+	// the first pinMode() of setup() comes after recorder_begin(), before any input is read
+	sim.onPins = [this]() {
+		if (!armed)
+			arm();
+	};
+	// timed at the write, like the unit's entries
+	sim.onWrite = [this](uint8_t port, uint8_t c) {
+		if (port == 1)
+			tx.push_back(std::make_pair(sim.now() - epochNs, c));
+	};
+}
+
+void Replay::arm()
+{
+	std::deque<uint64_t> seen[2]; // per port, from when the bytes the unit found may be there
+
+	armed = true;
+#ifdef FIELD_RECORDER
+	epochNs = recorder_epoch() * 1000ull;
+#endif
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const ReplayEntry &entry = entries[i];
+		uint8_t port = (entry.channel == RECORDER_RX) || (entry.channel == RECORDER_RX_SEEN);
+
+		switch (entry.channel)
+		{
+		case RECORDER_FINDA:
+		case RECORDER_SWITCH:
+		case RECORDER_ENDSTOP:
+			levels[entry.channel - RECORDER_FINDA].push_back(&entry);
+			break;
+		case RECORDER_RX_SEEN:
+		case RECORDER_CONSOLE_SEEN:
+			seen[port].insert(seen[port].end(), entry.value, entry.fromNs);
+			break;
+		case RECORDER_RX:
+		case RECORDER_CONSOLE:
+			sim.receive(port, entry.value, epochNs + (seen[port].empty() ? entry.fromNs : seen[port].front()));
+			if (!seen[port].empty())
+				seen[port].pop_front();
+			break;
+		}
+	}
+}
+
+/*************************/
+// Report
+/*************************/
+struct ReplayLine
+{
+	bool fromPrinter;
+	std::string text;
+	int64_t unitNs;	  // -1: not sent by the unit
+	int64_t replayNs; // -1: not sent by the replay
+};
+
+// lines of a byte stream, timed by their last byte
+static void splitLines(const std::vector<std::pair<uint64_t, uint8_t> > &bytes, bool fromPrinter, std::vector<ReplayLine> &lines)
+{
+	ReplayLine line;
+
+	line.fromPrinter = fromPrinter;
+	line.unitNs = -1;
+	line.replayNs = -1;
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		if (bytes[i].second == '\n')
+		{
+			line.unitNs = bytes[i].first;
+			lines.push_back(line);
+			line.text.clear();
+		}
+		else
+			line.text += ((bytes[i].second >= ' ') && (bytes[i].second < 0x7F)) ? (char)bytes[i].second : '?';
+	}
+	if (!line.text.empty())
+	{
+		line.unitNs = bytes.back().first;
+		lines.push_back(line);
+	}
+}
+
+static bool byUnitTime(const ReplayLine &a, const ReplayLine &b)
+{
+	return a.unitNs < b.unitNs;
+}
+
+bool Replay::report(FILE *out, bool json) const
+{
+	std::vector<std::pair<uint64_t, uint8_t> > unitRx, unitTx;
+	std::vector<ReplayLine> lines, sent, replayed;
+	size_t same = 0;
+	double worstMs = 0;
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].channel == RECORDER_RX)
+			unitRx.push_back(std::make_pair(entries[i].ns, entries[i].value));
+		else if (entries[i].channel == RECORDER_TX)
+			unitTx.push_back(std::make_pair(entries[i].ns, entries[i].value));
+	}
+	while ((same < unitTx.size()) && (same < tx.size()) && (unitTx[same].second == tx[same].second))
+		same++;
+	// what the replay sent after the end of the capture has nothing to be compared with
+	bool identical = (same == unitTx.size()) && ((same == tx.size()) || (tx[same].first > endNs()));
+
+	// the n-th line of the replay next to the n-th line of the unit
+	splitLines(unitTx, false, sent);
+	splitLines(tx, false, replayed);
+	for (size_t i = 0; i < replayed.size(); i++)
+	{
+		replayed[i].replayNs = replayed[i].unitNs;
+		replayed[i].unitNs = -1;
+		if (i >= sent.size())
+			continue;
+		sent[i].replayNs = replayed[i].replayNs;
+		if (fabs((sent[i].replayNs - sent[i].unitNs) / 1e6) > fabs(worstMs))
+			worstMs = (sent[i].replayNs - sent[i].unitNs) / 1e6;
+	}
+	splitLines(unitRx, true, lines);
+	lines.insert(lines.end(), sent.begin(), sent.end());
+	std::stable_sort(lines.begin(), lines.end(), byUnitTime);
+	if (replayed.size() > sent.size())
+		lines.insert(lines.end(), replayed.begin() + sent.size(), replayed.end()); // more than the unit sent
+
+	if (!json)
+	{
+		fprintf(out, "capture: %zu records, %zu entries over %.3f s, %lu lost\n", records.size(), entries.size(), endNs() / 1e9, lost);
+		if (lost)
+			fprintf(out, "WARNING: the unit dropped entries (R LOST), the replay is not exact\n");
+		fprintf(out, "\n   %-24s %10s %10s %10s\n", "printer", "unit s", "replay s", "delta ms");
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			const ReplayLine &l = lines[i];
+
+			fprintf(out, "%s  %-24s", l.fromPrinter ? ">" : "<", l.text.c_str());
+			if (l.unitNs >= 0)
+				fprintf(out, " %10.3f", l.unitNs / 1e9);
+			else
+				fprintf(out, " %10s", "-");
+			if (l.fromPrinter)
+				fprintf(out, "\n");
+			else if (l.replayNs < 0)
+				fprintf(out, " %10s\n", "-");
+			else if (l.unitNs < 0)
+				fprintf(out, " %10.3f\n", l.replayNs / 1e9);
+			else
+				fprintf(out, " %10.3f %+10.1f\n", l.replayNs / 1e9, (l.replayNs - l.unitNs) / 1e6);
+		}
+		if (identical)
+			fprintf(out, "\nprinter port: the replay sent the same %zu bytes, %+.1f ms apart at most\n", unitTx.size(), worstMs);
+		else
+			fprintf(out, "\nprinter port: the replay differs from byte %zu on (the unit sent %zu bytes, the replay %zu)\n",
+					same, unitTx.size(), tx.size());
+		return identical;
+	}
+
+	fprintf(out, "{\n  \"records\": %zu,\n  \"entries\": %zu,\n  \"lost\": %lu,\n  \"end_s\": %.6f,\n",
+			records.size(), entries.size(), lost, endNs() / 1e9);
+	fprintf(out, "  \"identical\": %s,\n  \"first_difference\": %ld,\n  \"worst_ms\": %.3f,\n  \"lines\": [",
+			identical ? "true" : "false", identical ? -1L : (long)same, worstMs);
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		const ReplayLine &l = lines[i];
+		std::string text;
+
+		for (size_t c = 0; c < l.text.size(); c++)
+			text += ((l.text[c] == '"') || (l.text[c] == '\\')) ? '?' : l.text[c];
+		fprintf(out, "%s\n    {\"from\": \"%s\", \"text\": \"%s\", \"unit_s\": %.6f, \"replay_s\": %.6f}", i ? "," : "",
+				l.fromPrinter ? "printer" : "mmu", text.c_str(), (l.unitNs < 0) ? -1.0 : l.unitNs / 1e9,
+				(l.replayNs < 0) ? -1.0 : l.replayNs / 1e9);
+	}
+	fprintf(out, "\n  ]\n}\n");
+	return identical;
+}
+
+#ifdef MMU_REPLAY
+/*************************/
+// mmu-replay: a field recorder capture against the firmware, in virtual time
+//   pio run -e replay, then .pio/build/replay/program capture.log
+/*************************/
+static MmuModel model;
+static SimBackend sim(model);
+static Replay replay(sim);
+
+static void usage()
+{
+	fprintf(stderr,
+			"usage: mmu-replay [options] CAPTURE\n"
+			"  CAPTURE                   debug console log of a unit built with FIELD_RECORDER\n"
+			"  --boot N                  which boot of the capture (R BEGIN), default 1\n"
+			"  --tail SECONDS            keep running after the last entry (default 1)\n"
+			"  --log FILE                firmware debug console output (- for stderr), a capture itself\n"
+			"  --call-ns NS              CPU time of one pin / clock / serial call (default 1000)\n"
+			"  --json                    machine readable report\n"
+			"exit status 1 if the firmware did not send the bytes the unit sent\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *capture = NULL;
+	const char *logPath = NULL;
+	FILE *logFile = NULL;
+	int boot = 1;
+	double tailS = 1;
+	bool json = false;
+	std::string error;
+	uint64_t endNs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool value = i + 1 < argc;
+
+		if (arg == "--json")
+			json = true;
+		else if ((arg == "--boot") && value)
+			boot = atoi(argv[++i]);
+		else if ((arg == "--tail") && value)
+			tailS = atof(argv[++i]);
+		else if ((arg == "--log") && value)
+			logPath = argv[++i];
+		else if ((arg == "--call-ns") && value)
+			sim.callNs = atoi(argv[++i]);
+		else if ((arg[0] != '-') && !capture)
+			capture = argv[i];
+		else
+			usage();
+	}
+	if (!capture || (boot < 1))
+		usage();
+	if (!replay.load(capture, boot, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 2;
+	}
+	if (logPath)
+	{
+		logFile = strcmp(logPath, "-") ? fopen(logPath, "w") : stderr;
+		if (!logFile)
+		{
+			perror(logPath);
+			return 2;
+		}
+	}
+
+	hal_set_backend(&sim);
+	sim.listen(0, [&logFile](uint8_t c) {
+		if (logFile)
+			fputc(c, logFile);
+	});
+	replay.start();
+	setup();
+	endNs = replay.endNs() + replay.epochNs + (uint64_t)(tailS * 1e9);
+	while (sim.now() < endNs)
+		loop();
+	if (logFile && (logFile != stderr))
+		fclose(logFile);
+	return replay.report(stdout, json) ? 0 : 1;
+}
+#endif // MMU_REPLAY
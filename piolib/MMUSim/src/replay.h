@@ -0,0 +1,83 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sim_backend.h"
+
+/*************************/
+// Replay of a field recorder capture (see recorder.h in the firmware)
+//
+// load() takes one boot of a debug console log: the persistent records loaded
+// at boot and the entries, each on the clock of the unit (time since
+// recorder_begin(), which the replay lines up with its own). start() stores
+// the records, so that the firmware boots with the unit's calibration,
+// positions and journal, then makes the inputs follow the capture:
+//   - the sensors read the level recorded last, at the virtual time of the read
+//     (the model only moves the motors)
+//   - the bytes the unit read from the printer and from the debug console are
+//     received when the unit's available() first reported them
+// A change is put just after the unit's last read that did not see it
+// (RECORDER_SINCE): all the unit's reads find what they found, and a firmware
+// that looks earlier finds it as soon as it may have been there.
+// The bytes the firmware sends to the printer are kept in tx, to be compared
+// with the ones the unit sent (report()).
+//
+// With the same firmware the replay runs the same commands on the same
+// inputs: it sends the same bytes, at the times of the unit within the
+// accuracy of the model timing. A changed firmware shows how it would have
+// done on that exact run: the replies that differ, the ones that come earlier or later.
+/*************************/
+
+struct ReplayEntry
+{
+	uint64_t ns; // unit time
+	uint64_t fromNs; // an input: the earliest time it may have been there
+	uint8_t channel; // RECORDER_xxx
+	uint8_t value;
+};
+
+struct ReplayRecord
+{
+	uint8_t key; // STORAGE_KEY_xxx
+	std::vector<uint8_t> data;
+};
+
+class Replay
+{
+public:
+	explicit Replay(SimBackend &sim);
+
+	// boot number boot (1: the first one) of a capture, false with error set
+	bool load(const char *path, int boot, std::string &error);
+
+	// before setup()
+	void start();
+
+	// time of the last entry
+	uint64_t endNs() const;
+
+	// printer traffic of the unit and of the replay, side by side; returns true
+	// if the firmware sent the same bytes
+	bool report(FILE *out, bool json) const;
+
+	std::vector<ReplayRecord> records;
+	std::vector<ReplayEntry> entries;
+	unsigned long lost; // entries dropped by the unit (R LOST)
+	std::vector<std::pair<uint64_t, uint8_t> > tx; // replay: time the byte was written (unit clock), byte
+	uint64_t epochNs; // virtual time of the replay's recorder_begin()
+	uint64_t tickNs;  // time resolution of the entries (4 us: AVR, and captures without it)
+
+private:
+	void arm();
+	int level(uint8_t channel, int modelLevel);
+
+	SimBackend &sim;
+	std::vector<const ReplayEntry *> levels[3]; // per sensor channel, in time order
+	size_t current[3];
+	bool armed;
+};
+
+#endif // REPLAY_H
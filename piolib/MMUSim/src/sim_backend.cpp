@@ -0,0 +1,196 @@
+#include "sim_backend.h"
+#include <Arduino.h>
+
+#define DEFAULT_BAUD 115200
+
+SimBackend::SimBackend(MmuModel &model) : callNs(1000), model(model), nowNs(0), seq(0)
+{
+	for (uint8_t i = 0; i < HAL_UART_COUNT; i++)
+	{
+		uarts[i].byteNs = 10 * 1000000000ull / DEFAULT_BAUD;
+		uarts[i].rxBusyUntil = 0;
+		uarts[i].txBusyUntil = 0;
+		uarts[i].txQueued = 0;
+	}
+}
+
+/*************************/
+// Clock and events
+/*************************/
+void SimBackend::runEvents(uint64_t until)
+{
+	while (!events.empty() && (events.top().time <= until))
+	{
+		Scheduled next = events.top();
+
+		events.pop();
+		if (next.time > nowNs)
+			nowNs = next.time;
+		next.event();
+		if (onPins)
+			onPins();
+	}
+}
+
+void SimBackend::advance(uint64_t ns)
+{
+	uint64_t until = nowNs + ns;
+
+	runEvents(until);
+	nowNs = until;
+}
+
+void SimBackend::call()
+{
+	advance(callNs);
+}
+
+void SimBackend::at(uint64_t time, SimEvent event)
+{
+	Scheduled scheduled;
+
+	scheduled.time = (time < nowNs) ? nowNs : time;
+	scheduled.seq = seq++;
+	scheduled.event = event;
+	events.push(scheduled);
+}
+
+uint64_t SimBackend::micros()
+{
+	call();
+	return nowNs / 1000;
+}
+
+void SimBackend::delayMicroseconds(uint32_t us)
+{
+	advance((uint64_t)us * 1000);
+}
+
+/*************************/
+// Pins
+/*************************/
+void SimBackend::pinMode(uint8_t pin, uint8_t mode)
+{
+	call();
+	model.pinMode(pin, mode);
+	if (onPins)
+		onPins();
+}
+
+void SimBackend::digitalWrite(uint8_t pin, uint8_t value)
+{
+	call();
+	model.write(pin, value, nowNs);
+	if (onPins)
+		onPins();
+}
+
+int SimBackend::digitalRead(uint8_t pin)
+{
+	int level;
+
+	call();
+	level = model.read(pin);
+	return pinInput ? pinInput(pin, level) : level;
+}
+
+/*************************/
+// Serial ports
+/*************************/
+void SimBackend::uartBegin(uint8_t port, uint32_t baud)
+{
+	if ((port < HAL_UART_COUNT) && baud)
+		uarts[port].byteNs = 10 * 1000000000ull / baud; // 8N1
+}
+
+void SimBackend::send(uint8_t port, const char *text, uint64_t time)
+{
+	Uart &uart = uarts[port];
+	uint64_t t = (time > uart.rxBusyUntil) ? time : uart.rxBusyUntil;
+
+	while (*text)
+	{
+		t += uart.byteNs;
+		if (dropByte && dropByte(port, t))
+		{
+			text++;
+			continue;
+		}
+		uart.rx.push_back(std::make_pair(t, (uint8_t)*text++));
+	}
+	uart.rxBusyUntil = t;
+}
+
+void SimBackend::receive(uint8_t port, uint8_t c, uint64_t time)
+{
+	Uart &uart = uarts[port];
+
+	if (time < uart.rxBusyUntil)
+		time = uart.rxBusyUntil;
+	uart.rx.push_back(std::make_pair(time, c));
+	uart.rxBusyUntil = time;
+}
+
+void SimBackend::listen(uint8_t port, SimListener listener)
+{
+	uarts[port].listener = listener;
+}
+
+int SimBackend::uartAvailable(uint8_t port)
+{
+	int count = 0;
+
+	call();
+	if (port >= HAL_UART_COUNT)
+		return 0;
+	for (size_t i = 0; (i < uarts[port].rx.size()) && (uarts[port].rx[i].first <= nowNs); i++)
+		count++;
+	return count;
+}
+
+int SimBackend::uartPeek(uint8_t port)
+{
+	call();
+	if ((port >= HAL_UART_COUNT) || uarts[port].rx.empty() || (uarts[port].rx.front().first > nowNs))
+		return -1;
+	return uarts[port].rx.front().second;
+}
+
+int SimBackend::uartRead(uint8_t port)
+{
+	int c = uartPeek(port);
+
+	if (c >= 0)
+		uarts[port].rx.pop_front();
+	return c;
+}
+
+int SimBackend::uartAvailableForWrite(uint8_t port)
+{
+	call();
+	return (port < HAL_UART_COUNT) ? SIM_TX_BUFFER - uarts[port].txQueued : 0;
+}
+
+void SimBackend::uartWrite(uint8_t port, uint8_t c)
+{
+	call();
+	if (port >= HAL_UART_COUNT)
+		return;
+	Uart &uart = uarts[port];
+
+	if (onWrite)
+		onWrite(port, c);
+	// a full buffer blocks the caller, like HardwareSerial::write()
+	while (uart.txQueued >= SIM_TX_BUFFER)
+		advance(uart.byteNs);
+
+	uart.txBusyUntil = ((uart.txBusyUntil > nowNs) ? uart.txBusyUntil : nowNs) + uart.byteNs;
+	uart.txQueued++;
+	at(uart.txBusyUntil, [this, port, c]() {
+		uarts[port].txQueued--;
+		if (dropByte && dropByte(port, nowNs))
+			return;
+		if (uarts[port].listener)
+			uarts[port].listener(c);
+	});
+}
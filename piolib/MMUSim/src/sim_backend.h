@@ -0,0 +1,103 @@
+#ifndef SIM_BACKEND_H
+#define SIM_BACKEND_H
+
+#include <hal.h>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "mmu_model.h"
+
+/*************************/
+// Virtual time backend
+//
+// The clock only moves when the firmware spends time: delay(), delayMicroseconds(),
+// a blocking serial write, and callNs for each pin, clock or serial call (the CPU
+// time of the call on the board). Events scheduled with at() run when the clock
+// reaches them: that is where the outside world (printer, operator, faults) acts.
+// Pins go to the MmuModel. The serial ports are byte queues timed at their baud
+// rate: a byte sent with send() is available once it has been fully received, a
+// byte written by the firmware leaves the 64 byte TX buffer one byte time later
+// and is given to the port's listener then.
+/*************************/
+
+#define SIM_TX_BUFFER 64
+
+typedef std::function<void()> SimEvent;
+typedef std::function<void(uint8_t c)> SimListener;
+
+class SimBackend : public HalBackend
+{
+public:
+	explicit SimBackend(MmuModel &model);
+
+	void pinMode(uint8_t pin, uint8_t mode) override;
+	void digitalWrite(uint8_t pin, uint8_t value) override;
+	int digitalRead(uint8_t pin) override;
+
+	uint64_t micros() override;
+	void delayMicroseconds(uint32_t us) override;
+
+	void uartBegin(uint8_t port, uint32_t baud) override;
+	int uartAvailable(uint8_t port) override;
+	int uartRead(uint8_t port) override;
+	int uartPeek(uint8_t port) override;
+	int uartAvailableForWrite(uint8_t port) override;
+	void uartWrite(uint8_t port, uint8_t c) override;
+
+	// virtual time in ns
+	uint64_t now() const { return nowNs; }
+	void advance(uint64_t ns);
+
+	// run event at the given time (now if it is in the past)
+	void at(uint64_t time, SimEvent event);
+
+	// bytes towards the firmware, their reception starts at time
+	void send(uint8_t port, const char *text, uint64_t time);
+	// one byte towards the firmware, fully received at time (a recorded capture, in time order)
+	void receive(uint8_t port, uint8_t c, uint64_t time);
+	// bytes from the firmware
+	void listen(uint8_t port, SimListener listener);
+
+	uint32_t callNs; // CPU time of one HAL call
+	// after every pin change and event, the inputs may have changed too (see PinTrace)
+	std::function<void()> onPins;
+	// true to lose a byte on the line (fault injection), time is when it would arrive
+	std::function<bool(uint8_t port, uint64_t time)> dropByte;
+	// the level the firmware reads on a pin instead of the model's (replay)
+	std::function<int(uint8_t pin, int level)> pinInput;
+	// every byte the firmware writes, when it writes it (replay)
+	std::function<void(uint8_t port, uint8_t c)> onWrite;
+
+private:
+	struct Scheduled
+	{
+		uint64_t time;
+		uint64_t seq;
+		SimEvent event;
+		bool operator<(const Scheduled &other) const
+		{
+			return (time != other.time) ? (time > other.time) : (seq > other.seq);
+		}
+	};
+	struct Uart
+	{
+		uint64_t byteNs;
+		std::deque<std::pair<uint64_t, uint8_t> > rx; // arrival time, byte
+		uint64_t rxBusyUntil;
+		uint64_t txBusyUntil;
+		unsigned txQueued;
+		SimListener listener;
+	};
+
+	void call();
+	void runEvents(uint64_t until);
+
+	MmuModel &model;
+	uint64_t nowNs;
+	uint64_t seq;
+	std::priority_queue<Scheduled> events;
+	Uart uarts[HAL_UART_COUNT];
+};
+
+#endif // SIM_BACKEND_H
@@ -0,0 +1,539 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "sim_backend.h"
+#include "printer_host.h"
+#include "pin_trace.h"
+#include "application.h"
+#include "calibration.h"
+#include "stats.h"
+
+/*************************/
+// mmu-sim: the firmware against the MMU model, in virtual time
+//
+// Boots the firmware, plays the printer side of the protocol with the given
+// commands and reports how long each one takes on the machine (see usage()).
+// Build with `pio run -e sim`, the program is .pio/build/sim/program.
+/*************************/
+
+// the native-model and replay builds have their own main(), see model_host.cpp and replay.cpp
+#if !defined(MMU_HOST_MODEL) && !defined(MMU_REPLAY)
+
+#define SIM_OPERATOR_POLL_NS 10000000ull // 10 ms
+#define SIM_CONSOLE_NS 1000000000ull	 // 1 s for a console command and its output
+
+struct SimFault
+{
+	std::string kind;
+	double startS;
+	double endS;
+	double value; // NAN: the default of the kind
+};
+
+// a failure counted by the firmware, most of them then wait in fixTheProblem()
+struct SimProblem
+{
+	int failure; // STATS_FAIL_xxx
+	uint64_t startNs;
+	uint64_t endNs; // fixTheProblem() resumed, 0 if not (yet)
+	bool waited;	// problemPending was seen
+};
+
+struct SimOptions
+{
+	std::vector<std::string> commands;
+	std::vector<std::string> console;
+	const char *logPath;
+	const char *statePath;
+	bool json;
+	double operatorS;
+	double limitS;
+	std::vector<SimFault> faults;
+	const char *vcdPath;
+	double vcdFromS;
+	double vcdToS;
+	bool check;
+};
+
+static MmuModel model;
+static SimBackend sim(model);
+static PrinterHost printer(sim, model);
+static PinTrace pins(model);
+static SimOptions options;
+static FILE *logFile = NULL;
+static uint32_t operatorCalls = 0;
+static bool operatorCalled = false;
+static bool booted = false;
+static uint16_t failuresSeen[STATS_FAILURES];
+static std::vector<SimProblem> problems;
+static double serialDrop = 0;
+
+static void usage()
+{
+	fprintf(stderr,
+			"usage: mmu-sim [options]\n"
+			"  --commands \"T1 C0 T2 C0\"  printer commands, in order (after the S1 / S2 / P0 handshake)\n"
+			"  --script FILE             more commands, one per line, # comments\n"
+			"  --set NAME=VALUE          model parameter (see --params)\n"
+			"  --cal NAME=VALUE          calibration value, as the K console command (stored before boot)\n"
+			"  --tip SLOT=MM             initial filament tip position\n"
+			"  --state FILE              load the model positions from FILE if it exists, save them at the end\n"
+			"  --eeprom FILE             EEPROM image (kept between runs: warm boot, statistics)\n"
+			"  --log FILE                firmware debug console output (- for stderr)\n"
+			"  --vcd FILE                pin transitions as a Value Change Dump (GTKWave)\n"
+			"  --vcd-window FROM:TO      only the transitions between these times (s)\n"
+			"  --check                   exit status 1 if a step broke a driver limit as well\n"
+			"  --console LINE            debug console command sent at the end (E: event trace, to --log)\n"
+			"  --operator SECONDS        time the operator takes to answer fixTheProblem() (default 30)\n"
+			"  --fault KIND:AT:FOR[:VALUE] inject a fault at AT s for FOR s, KIND (VALUE):\n"
+			"                              finda_stuck (level, default: the one at AT)\n"
+			"                              slip (fraction of the extruder steps, default 1)\n"
+			"                              selector_loss (fraction of the selector steps lost, default 0.5)\n"
+			"                              switch_bounce (probability of a wrong read, default 0.5)\n"
+			"                              serial_drop (fraction of the Serial1 bytes lost, default 0.1)\n"
+			"  --seed N                  random draws of the faults\n"
+			"  --timeout SECONDS         longest time for one command (default 600)\n"
+			"  --think MS                printer time between an ack and the next command (default 0)\n"
+			"  --limit SECONDS           virtual time limit of the whole run (default 86400)\n"
+			"  --call-ns NS              CPU time of one pin / clock / serial call (default 1000)\n"
+			"  --json                    machine readable report\n"
+			"  --params                  list the model parameters\n");
+	exit(2);
+}
+
+static bool split(const char *arg, std::string &name, double &value)
+{
+	const char *eq = strchr(arg, '=');
+
+	if (!eq)
+		return false;
+	name.assign(arg, eq - arg);
+	value = atof(eq + 1);
+	return true;
+}
+
+static void readScript(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[128];
+
+	if (!f)
+	{
+		perror(path);
+		exit(2);
+	}
+	while (fgets(line, sizeof(line), f))
+	{
+		char *end = line + strcspn(line, "#\r\n");
+
+		*end = 0;
+		for (char *word = strtok(line, " \t"); word; word = strtok(NULL, " \t"))
+			options.commands.push_back(word);
+	}
+	fclose(f);
+}
+
+static void parseOptions(int argc, char **argv)
+{
+	std::vector<std::pair<std::string, double> > calibrations;
+	std::string name;
+	double value;
+
+	options.logPath = NULL;
+	options.statePath = NULL;
+	options.json = false;
+	options.operatorS = 30;
+	options.limitS = 86400;
+	options.vcdPath = NULL;
+	options.vcdFromS = 0;
+	options.vcdToS = 1e12;
+	options.check = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (arg == "--json")
+			options.json = true;
+		else if (arg == "--check")
+			options.check = true;
+		else if (arg == "--params")
+		{
+			model.listParams(stdout);
+			exit(0);
+		}
+		else if (!next)
+			usage();
+		else if (arg == "--commands")
+		{
+			std::string list = argv[++i];
+			char *text = &list[0];
+
+			for (char *word = strtok(text, " \t,"); word; word = strtok(NULL, " \t,"))
+				options.commands.push_back(word);
+		}
+		else if (arg == "--script")
+			readScript(argv[++i]);
+		else if (arg == "--set")
+		{
+			if (!split(argv[++i], name, value) || !model.set(name.c_str(), value))
+			{
+				fprintf(stderr, "unknown model parameter: %s\n", argv[i]);
+				exit(2);
+			}
+		}
+		else if (arg == "--cal")
+		{
+			if (!split(argv[++i], name, value))
+				usage();
+			calibrations.push_back(std::make_pair(name, value));
+		}
+		else if (arg == "--tip")
+		{
+			if (!split(argv[++i], name, value) || (atoi(name.c_str()) < 0) || (atoi(name.c_str()) >= MODEL_SLOTS))
+				usage();
+			model.setTip(atoi(name.c_str()), value);
+		}
+		else if (arg == "--state")
+			options.statePath = argv[++i];
+		else if (arg == "--eeprom")
+			setenv("MMU_EEPROM", argv[++i], 1);
+		else if (arg == "--log")
+			options.logPath = argv[++i];
+		else if (arg == "--fault")
+		{
+			SimFault fault;
+			char kind[32];
+			double duration;
+			int fields = sscanf(argv[++i], "%31[a-z_]:%lf:%lf:%lf", kind, &fault.startS, &duration, &fault.value);
+
+			if (fields < 3)
+				usage();
+			if (fields < 4)
+				fault.value = NAN;
+			fault.kind = kind;
+			fault.endS = fault.startS + duration;
+			if ((fault.kind != "finda_stuck") && (fault.kind != "slip") && (fault.kind != "selector_loss") &&
+				(fault.kind != "switch_bounce") && (fault.kind != "serial_drop"))
+			{
+				fprintf(stderr, "unknown fault: %s\n", kind);
+				exit(2);
+			}
+			options.faults.push_back(fault);
+		}
+		else if (arg == "--seed")
+			model.seed(strtoul(argv[++i], NULL, 0));
+		else if (arg == "--vcd")
+			options.vcdPath = argv[++i];
+		else if (arg == "--vcd-window")
+		{
+			if (sscanf(argv[++i], "%lf:%lf", &options.vcdFromS, &options.vcdToS) != 2)
+				usage();
+		}
+		else if (arg == "--console")
+			options.console.push_back(argv[++i]);
+		else if (arg == "--operator")
+			options.operatorS = atof(argv[++i]);
+		else if (arg == "--timeout")
+			printer.timeoutNs = (uint64_t)(atof(argv[++i]) * 1e9);
+		else if (arg == "--think")
+			printer.thinkNs = (uint64_t)(atof(argv[++i]) * 1e6);
+		else if (arg == "--limit")
+			options.limitS = atof(argv[++i]);
+		else if (arg == "--call-ns")
+			sim.callNs = atoi(argv[++i]);
+		else
+			usage();
+	}
+
+	if (options.statePath)
+		model.load(options.statePath); // a missing file is a first run
+
+	// stored like the K command does, so that setup() loads them
+	if (!calibrations.empty())
+	{
+		calibration_load();
+		for (size_t i = 0; i < calibrations.size(); i++)
+		{
+			if (!calibration_set(calibrations[i].first.c_str(), (long)calibrations[i].second))
+			{
+				fprintf(stderr, "bad calibration value: %s=%g\n", calibrations[i].first.c_str(), calibrations[i].second);
+				exit(2);
+			}
+		}
+		calibration_commit();
+	}
+}
+
+/*************************/
+// Faults: set in the model (or on the printer link) for their time window
+/*************************/
+static void applyFault(const SimFault &fault, bool on)
+{
+	double value = fault.value;
+
+	if (fault.kind == "finda_stuck")
+		model.faults.findaStuck = on ? (isnan(value) ? model.findaActive() : (value != 0)) : -1;
+	else if (fault.kind == "slip")
+		model.faults.slip = on ? (isnan(value) ? 1.0 : value) : 0;
+	else if (fault.kind == "selector_loss")
+		model.faults.selectorLoss = on ? (isnan(value) ? 0.5 : value) : 0;
+	else if (fault.kind == "switch_bounce")
+		model.faults.switchBounce = on ? (isnan(value) ? 0.5 : value) : 0;
+	else if (fault.kind == "serial_drop")
+		serialDrop = on ? (isnan(value) ? 0.1 : value) : 0;
+}
+
+static void scheduleFaults()
+{
+	for (size_t i = 0; i < options.faults.size(); i++)
+	{
+		const SimFault &fault = options.faults[i];
+
+		sim.at((uint64_t)(fault.startS * 1e9), [&fault]() { applyFault(fault, true); });
+		sim.at((uint64_t)(fault.endS * 1e9), [&fault]() { applyFault(fault, false); });
+	}
+	sim.dropByte = [](uint8_t port, uint64_t) { return (port == 1) && model.draw(serialDrop); };
+}
+
+/*************************/
+// Failures: fixTheProblem() counts the failure first, then waits for the
+// operator. The poll below sees the count within SIM_OPERATOR_POLL_NS.
+/*************************/
+static void problemWatch()
+{
+	if (!booted)
+		return;
+	for (uint8_t i = 0; i < STATS_FAILURES; i++)
+	{
+		if (stats.failures[i] != failuresSeen[i])
+		{
+			SimProblem problem;
+
+			problem.failure = i;
+			problem.startNs = sim.now();
+			problem.endNs = 0;
+			problem.waited = false;
+			problems.push_back(problem);
+		}
+	}
+	memcpy(failuresSeen, stats.failures, sizeof(failuresSeen));
+	if (problems.empty() || problems.back().endNs)
+		return;
+	if (problemPending)
+		problems.back().waited = true;
+	else if (problems.back().waited)
+		problems.back().endNs = sim.now();
+}
+
+/*************************/
+// Operator: answers fixTheProblem() on the debug console after options.operatorS
+/*************************/
+static void operatorWatch()
+{
+	problemWatch();
+	if (problemPending && !operatorCalled)
+	{
+		operatorCalled = true;
+		operatorCalls++;
+		sim.at(sim.now() + (uint64_t)(options.operatorS * 1e9), []() {
+			sim.send(0, "\n", sim.now());
+			operatorCalled = false;
+		});
+	}
+	sim.at(sim.now() + SIM_OPERATOR_POLL_NS, operatorWatch);
+}
+
+/*************************/
+// Report
+/*************************/
+static double seconds(uint64_t ns)
+{
+	return ns / 1e9;
+}
+
+static void report(uint64_t bootNs, const std::vector<std::vector<uint32_t> > &phases)
+{
+	static const char *phaseNames[STATS_PHASES] = {"unload", "select", "feed", "c"};
+	static const char *axisNames[MODEL_AXES] = {"idler", "selector", "extruder"};
+	ModelCounters &c = model.counters;
+	uint64_t total = 0;
+
+	if (!options.json)
+	{
+		printf("%-8s %10.3f s\n", "boot", seconds(bootNs));
+		for (size_t i = 0; i < printer.results.size(); i++)
+		{
+			const CommandResult &r = printer.results[i];
+
+			if (!r.acked)
+			{
+				printf("%-8s    no ack\n", r.command.c_str());
+				continue;
+			}
+			total += r.ackNs - r.sentNs;
+			printf("%-8s %10.3f s", r.command.c_str(), seconds(r.ackNs - r.sentNs));
+			for (uint8_t p = 0; p < STATS_PHASES; p++)
+			{
+				if (phases[i][p])
+					printf("  %s %.3f", phaseNames[p], phases[i][p] / 1000.0);
+			}
+			printf("\n");
+		}
+		printf("%-8s %10.3f s\n", "total", seconds(total));
+		printf("virtual time %.3f s, operator calls %u%s\n", seconds(sim.now()), operatorCalls, printer.timedOut() ? ", TIMEOUT" : "");
+		for (uint8_t a = 0; a < MODEL_AXES; a++)
+		{
+			const StepTiming &t = pins.timing[a];
+
+			printf("%-8s steps %u lost %u shortest interval %.1f us (stall %.1f us)\n", axisNames[a],
+				   c.steps[a], c.lost[a], c.minIntervalUs[a], model.params.stallUs[a]);
+			printf("%-8s step high %.0f ns low %.0f ns, dir setup %.0f ns hold %.0f ns: %u driver limit violations, %u steps while disabled\n",
+				   "", t.highNs, t.lowNs, t.dirSetupNs, t.dirHoldNs, t.violations, t.disabled);
+		}
+		printf("filament slips %u jams %u, margins: selector %.1f idler %.1f full steps\n",
+			   c.slips, c.jams, c.selectorMargin, c.idlerMargin);
+		for (size_t i = 0; i < options.faults.size(); i++)
+		{
+			printf("fault %s from %.3f s to %.3f s\n", options.faults[i].kind.c_str(), options.faults[i].startS, options.faults[i].endS);
+		}
+		for (size_t i = 0; i < problems.size(); i++)
+		{
+			printf("failure %d at %.3f s", problems[i].failure, seconds(problems[i].startNs));
+			if (problems[i].endNs)
+				printf(", fixTheProblem() until %.3f s\n", seconds(problems[i].endNs));
+			else
+				printf("%s\n", problems[i].waited ? ", still in fixTheProblem()" : "");
+		}
+		return;
+	}
+
+	printf("{\n  \"boot_s\": %.6f,\n  \"commands\": [", seconds(bootNs));
+	for (size_t i = 0; i < printer.results.size(); i++)
+	{
+		const CommandResult &r = printer.results[i];
+
+		if (r.acked)
+			total += r.ackNs - r.sentNs;
+		printf("%s\n    {\"command\": \"%s\", \"acked\": %s, \"start_s\": %.6f, \"seconds\": %.6f, \"reply\": \"%s\", \"phases_s\": {",
+			   i ? "," : "", r.command.c_str(), r.acked ? "true" : "false", seconds(r.sentNs),
+			   r.acked ? seconds(r.ackNs - r.sentNs) : 0.0, r.reply.c_str());
+		for (uint8_t p = 0; p < STATS_PHASES; p++)
+			printf("%s\"%s\": %.3f", p ? ", " : "", phaseNames[p], phases[i][p] / 1000.0);
+		printf("}}");
+	}
+	printf("\n  ],\n  \"total_s\": %.6f,\n  \"virtual_s\": %.6f,\n  \"timed_out\": %s,\n  \"operator_calls\": %u,\n",
+		   seconds(total), seconds(sim.now()), printer.timedOut() ? "true" : "false", operatorCalls);
+	printf("  \"faults\": [");
+	for (size_t i = 0; i < options.faults.size(); i++)
+	{
+		printf("%s{\"kind\": \"%s\", \"start_s\": %.6f, \"end_s\": %.6f}", i ? ", " : "",
+			   options.faults[i].kind.c_str(), options.faults[i].startS, options.faults[i].endS);
+	}
+	printf("],\n  \"problems\": [");
+	for (size_t i = 0; i < problems.size(); i++)
+	{
+		printf("%s{\"failure\": %d, \"start_s\": %.6f, \"operator\": %s, \"end_s\": %.6f}", i ? ", " : "",
+			   problems[i].failure, seconds(problems[i].startNs), problems[i].waited ? "true" : "false",
+			   problems[i].endNs ? seconds(problems[i].endNs) : -1.0);
+	}
+	printf("],\n");
+	printf("  \"model\": {\"slips\": %u, \"jams\": %u, \"faulted\": %u, \"selector_margin\": %.3f, \"idler_margin\": %.3f",
+		   c.slips, c.jams, c.faulted, isinf(c.selectorMargin) ? -1.0 : c.selectorMargin, isinf(c.idlerMargin) ? -1.0 : c.idlerMargin);
+	for (uint8_t a = 0; a < MODEL_AXES; a++)
+	{
+		const StepTiming &t = pins.timing[a];
+
+		printf(", \"%s\": {\"steps\": %u, \"lost\": %u, \"min_interval_us\": %.3f, \"stall_us\": %.3f", axisNames[a],
+			   c.steps[a], c.lost[a], isinf(c.minIntervalUs[a]) ? -1.0 : c.minIntervalUs[a], model.params.stallUs[a]);
+		printf(", \"step_high_ns\": %.0f, \"step_low_ns\": %.0f, \"dir_setup_ns\": %.0f, \"dir_hold_ns\": %.0f, \"driver_violations\": %u, \"disabled_steps\": %u}",
+			   isinf(t.highNs) ? -1.0 : t.highNs, isinf(t.lowNs) ? -1.0 : t.lowNs, isinf(t.dirSetupNs) ? -1.0 : t.dirSetupNs,
+			   isinf(t.dirHoldNs) ? -1.0 : t.dirHoldNs, t.violations, t.disabled);
+	}
+	printf("}\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<std::vector<uint32_t> > phases;
+	std::vector<uint32_t> phaseStart(STATS_PHASES);
+	uint64_t bootNs;
+	uint64_t limitNs;
+
+	hal_set_backend(&sim);
+	parseOptions(argc, argv);
+	limitNs = (uint64_t)(options.limitS * 1e9);
+
+	if (options.logPath)
+	{
+		logFile = strcmp(options.logPath, "-") ? fopen(options.logPath, "w") : stderr;
+		if (!logFile)
+		{
+			perror(options.logPath);
+			return 2;
+		}
+	}
+	if (options.vcdPath && !pins.openVcd(options.vcdPath, (uint64_t)(options.vcdFromS * 1e9), (uint64_t)(options.vcdToS * 1e9)))
+	{
+		perror(options.vcdPath);
+		return 2;
+	}
+	sim.onPins = []() { pins.sample(sim.now()); };
+	sim.listen(0, [](uint8_t c) {
+		if (logFile)
+			fputc(c, logFile);
+	});
+
+	// per command phase times, from the firmware's own counters
+	printer.onSend = [&](const std::string &) {
+		phaseStart.assign(stats.phaseMs, stats.phaseMs + STATS_PHASES);
+	};
+	printer.onAck = [&](const CommandResult &) {
+		std::vector<uint32_t> spent(STATS_PHASES);
+
+		for (uint8_t p = 0; p < STATS_PHASES; p++)
+			spent[p] = stats.phaseMs[p] - phaseStart[p];
+		phases.push_back(spent);
+	};
+	printer.script(options.commands);
+	scheduleFaults();
+	operatorWatch();
+
+	setup();
+	bootNs = sim.now();
+	booted = true;
+	memcpy(failuresSeen, stats.failures, sizeof(failuresSeen));
+	while (!printer.done() && (sim.now() < limitNs))
+		loop();
+	for (size_t i = 0; i < options.console.size(); i++)
+	{
+		uint64_t end = sim.now() + SIM_CONSOLE_NS;
+
+		sim.send(0, (options.console[i] + "\n").c_str(), sim.now());
+		while (sim.now() < end)
+			loop();
+	}
+
+	// the last command may not have been acknowledged
+	while (phases.size() < printer.results.size())
+		phases.push_back(std::vector<uint32_t>(STATS_PHASES));
+	if (options.statePath)
+		model.save(options.statePath);
+	if (logFile && (logFile != stderr))
+		fclose(logFile);
+	pins.closeVcd();
+	report(bootNs, phases);
+	if (options.check)
+	{
+		for (uint8_t a = 0; a < MODEL_AXES; a++)
+		{
+			if (pins.timing[a].violations)
+				return 1;
+		}
+	}
+	return (printer.timedOut() || (sim.now() >= limitNs)) ? 1 : 0;
+}
+
+#endif // !MMU_HOST_MODEL && !MMU_REPLAY
@@ -0,0 +1,168 @@
+#include "Arduino.h"
+#include "hal.h"
+#include "host_backend.h"
+
+static HostBackend hostBackend;
+static HalBackend *backend = &hostBackend;
+
+void hal_set_backend(HalBackend *newBackend)
+{
+	backend = newBackend ? newBackend : &hostBackend;
+}
+
+HalBackend *hal_backend()
+{
+	return backend;
+}
+
+/*************************/
+// Timers
+/*************************/
+struct HalTimer
+{
+	HalTimerCallback callback;
+	uint32_t periodUs;
+	uint64_t due;
+};
+
+static HalTimer timers[HAL_TIMER_COUNT];
+static bool inTimer = false;
+
+void hal_timer_start(uint8_t id, uint32_t periodUs, HalTimerCallback callback)
+{
+	if (id >= HAL_TIMER_COUNT)
+		return;
+	timers[id].callback = callback;
+	timers[id].periodUs = periodUs ? periodUs : 1;
+	timers[id].due = backend->micros() + timers[id].periodUs;
+}
+
+void hal_timer_stop(uint8_t id)
+{
+	if (id < HAL_TIMER_COUNT)
+		timers[id].callback = NULL;
+}
+
+void hal_timer_service(uint64_t now)
+{
+	if (inTimer)
+		return; // no nesting, like an interrupt handler
+	inTimer = true;
+	for (uint8_t i = 0; i < HAL_TIMER_COUNT; i++)
+	{
+		while (timers[i].callback && (timers[i].due <= now))
+		{
+			timers[i].due += timers[i].periodUs;
+			timers[i].callback();
+		}
+	}
+	inTimer = false;
+}
+
+/*************************/
+// Pins and time
+/*************************/
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	backend->pinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	backend->digitalWrite(pin, value);
+}
+
+int digitalRead(uint8_t pin)
+{
+	return backend->digitalRead(pin);
+}
+
+unsigned long micros()
+{
+	uint64_t now = backend->micros();
+
+	hal_timer_service(now);
+	return (unsigned long)now;
+}
+
+unsigned long millis()
+{
+	uint64_t now = backend->micros();
+
+	hal_timer_service(now);
+	return (unsigned long)(now / 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	backend->delayMicroseconds(us);
+	hal_timer_service(backend->micros());
+}
+
+void delay(unsigned long ms)
+{
+	while (ms--)
+		delayMicroseconds(1000);
+}
+
+/*************************/
+// Serial ports
+/*************************/
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+
+	while (size--)
+		n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(long value)
+{
+	char text[24];
+
+	snprintf(text, sizeof(text), "%ld", value);
+	return write(text);
+}
+
+size_t Print::print(unsigned long value)
+{
+	char text[24];
+
+	snprintf(text, sizeof(text), "%lu", value);
+	return write(text);
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	backend->uartBegin(port, baud);
+}
+
+int HardwareSerial::available()
+{
+	return backend->uartAvailable(port);
+}
+
+int HardwareSerial::read()
+{
+	return backend->uartRead(port);
+}
+
+int HardwareSerial::peek()
+{
+	return backend->uartPeek(port);
+}
+
+int HardwareSerial::availableForWrite()
+{
+	return backend->uartAvailableForWrite(port);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	backend->uartWrite(port, c);
+	return 1;
+}
@@ -0,0 +1,123 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+
+/*************************/
+// Arduino API for the native build
+//
+// The subset of the Arduino core the firmware uses, implemented on top of the
+// HalBackend in hal.h. Flash strings are plain strings on the host.
+/*************************/
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+// STM32 port pin names (the SKR mini pins in config.h)
+enum
+{
+	PA0, PA1, PA2, PA3, PA4, PA5, PA6, PA7, PA8, PA9, PA10, PA11, PA12, PA13, PA14, PA15,
+	PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7, PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15,
+	PC0, PC1, PC2, PC3, PC4, PC5, PC6, PC7, PC8, PC9, PC10, PC11, PC12, PC13, PC14, PC15
+};
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void setup();
+void loop();
+
+class Print
+{
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() {}
+
+	size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+
+	size_t print(const __FlashStringHelper *str) { return write((const char *)str); }
+	size_t print(const char *str) { return write(str); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(int value) { return print((long)value); }
+	size_t print(unsigned int value) { return print((unsigned long)value); }
+	size_t print(long value);
+	size_t print(unsigned long value);
+
+	template <typename T>
+	size_t println(T value)
+	{
+		size_t n = print(value);
+		return n + println();
+	}
+	size_t println() { return write("\r\n"); }
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+	explicit HardwareSerial(uint8_t port) : port(port) {}
+
+	void begin(unsigned long baud);
+	void end() {}
+	operator bool() { return true; }
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	int availableForWrite() override;
+	size_t write(uint8_t c) override;
+	using Print::write;
+
+private:
+	uint8_t port;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // Arduino_h
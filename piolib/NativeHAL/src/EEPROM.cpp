@@ -0,0 +1,55 @@
+#include "EEPROM.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+EEPROMClass EEPROM;
+
+void EEPROMClass::open()
+{
+	const char *path = getenv("MMU_EEPROM");
+
+	opened = true;
+	memset(data, 0xFF, sizeof(data));
+	if (!path)
+		return;
+	fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		perror(path);
+		return;
+	}
+	if (pread(fd, data, sizeof(data), 0) < (ssize_t)sizeof(data))
+		pwrite(fd, data, sizeof(data), 0); // new (or short) file, store the erased image
+}
+
+uint8_t *EEPROMClass::image()
+{
+	if (!opened)
+		open();
+	return data;
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+	if ((address < 0) || (address >= EEPROM_SIZE))
+		return 0xFF;
+	return image()[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+	if ((address < 0) || (address >= EEPROM_SIZE))
+		return;
+	image()[address] = value;
+	if (fd >= 0)
+		pwrite(fd, &value, 1, address);
+}
+
+void EEPROMClass::update(int address, uint8_t value)
+{
+	if (read(address) != value)
+		write(address, value);
+}
@@ -0,0 +1,37 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+/*************************/
+// EEPROM emulation for the native build
+//
+// 4 KB like the ATmega2560, erased to 0xFF. When the MMU_EEPROM environment
+// variable names a file the content is loaded from it on first access and every
+// write goes through to it, so calibration and statistics survive a restart.
+/*************************/
+
+#define EEPROM_SIZE 4096
+
+class EEPROMClass
+{
+public:
+	uint8_t read(int address);
+	void write(int address, uint8_t value);
+	void update(int address, uint8_t value);
+	uint16_t length() { return EEPROM_SIZE; }
+
+	// the whole image, for a simulator that prepares or inspects it
+	uint8_t *image();
+
+private:
+	void open();
+
+	uint8_t data[EEPROM_SIZE];
+	bool opened = false;
+	int fd = -1;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_h
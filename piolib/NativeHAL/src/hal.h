@@ -0,0 +1,62 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+/*************************/
+// Hardware abstraction for the native build
+//
+// The Arduino API of this library (Arduino.h, EEPROM.h) forwards every pin,
+// clock and serial port access to the current HalBackend. HostBackend is the
+// default: it runs the firmware in real time on a Linux host, see host_backend.h.
+// A simulator or a test bench installs its own backend with hal_set_backend()
+// before setup() runs, and builds with NATIVE_CUSTOM_MAIN to drive the loop itself.
+/*************************/
+
+#define HAL_PIN_COUNT 80   // covers the STM32 port names (PA0..PC15) and the Mega pin numbers
+#define HAL_UART_COUNT 2   // 0: Serial (debug console), 1: Serial1 (printer)
+#define HAL_TIMER_COUNT 4
+
+class HalBackend
+{
+public:
+	virtual ~HalBackend() {}
+
+	// GPIO, mode is INPUT, OUTPUT or INPUT_PULLUP
+	virtual void pinMode(uint8_t pin, uint8_t mode) = 0;
+	virtual void digitalWrite(uint8_t pin, uint8_t value) = 0;
+	virtual int digitalRead(uint8_t pin) = 0;
+
+	// time in microseconds since boot, only has to be monotonic (a simulator runs it virtually)
+	virtual uint64_t micros() = 0;
+	virtual void delayMicroseconds(uint32_t us) = 0;
+
+	// UART, read() and peek() return -1 when nothing was received
+	virtual void uartBegin(uint8_t port, uint32_t baud) {}
+	virtual int uartAvailable(uint8_t port) = 0;
+	virtual int uartRead(uint8_t port) = 0;
+	virtual int uartPeek(uint8_t port) = 0;
+	virtual int uartAvailableForWrite(uint8_t port) = 0;
+	virtual void uartWrite(uint8_t port, uint8_t c) = 0;
+};
+
+void hal_set_backend(HalBackend *backend);
+HalBackend *hal_backend();
+
+/*************************/
+// Timers
+//
+// Periodic callbacks on the backend clock. There are no interrupts on the host:
+// a due timer runs from the next micros(), millis() or delay call of the firmware,
+// which is where an interrupt would have been taken on the board as well.
+/*************************/
+typedef void (*HalTimerCallback)();
+
+// start (or restart) timer id, callback runs every periodUs
+void hal_timer_start(uint8_t id, uint32_t periodUs, HalTimerCallback callback);
+void hal_timer_stop(uint8_t id);
+
+// run the due timers, called by the Arduino time functions
+void hal_timer_service(uint64_t now);
+
+#endif // HAL_H
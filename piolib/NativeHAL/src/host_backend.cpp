@@ -0,0 +1,174 @@
+#include "host_backend.h"
+#include "Arduino.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+HostBackend::HostBackend()
+{
+	memset(modes, INPUT, sizeof(modes));
+	memset(levels, LOW, sizeof(levels));
+	memset(inputSet, 0, sizeof(inputSet));
+	startNs = monotonic_ns();
+	for (uint8_t i = 0; i < HAL_UART_COUNT; i++)
+	{
+		fds[i][0] = fds[i][1] = -1;
+		pending[i] = -1;
+	}
+}
+
+/*************************/
+// GPIO
+/*************************/
+void HostBackend::pinMode(uint8_t pin, uint8_t mode)
+{
+	if (pin >= HAL_PIN_COUNT)
+		return;
+	modes[pin] = mode;
+	if ((mode == INPUT_PULLUP) && !inputSet[pin])
+		levels[pin] = HIGH;
+}
+
+void HostBackend::digitalWrite(uint8_t pin, uint8_t value)
+{
+	if (pin < HAL_PIN_COUNT)
+		levels[pin] = value ? HIGH : LOW;
+}
+
+int HostBackend::digitalRead(uint8_t pin)
+{
+	return (pin < HAL_PIN_COUNT) ? levels[pin] : LOW;
+}
+
+void HostBackend::setInput(uint8_t pin, uint8_t value)
+{
+	if (pin >= HAL_PIN_COUNT)
+		return;
+	inputSet[pin] = true;
+	levels[pin] = value ? HIGH : LOW;
+}
+
+/*************************/
+// Time
+/*************************/
+uint64_t HostBackend::micros()
+{
+	return (monotonic_ns() - startNs) / 1000;
+}
+
+// a sleep overshoots by the timer slack (50 us and more), three times a step
+// delay: the end of a delay is spun on the clock
+#define HOST_SPIN_NS 200000ull
+
+void HostBackend::delayMicroseconds(uint32_t us)
+{
+	uint64_t end = monotonic_ns() + (uint64_t)us * 1000;
+	uint64_t now = monotonic_ns();
+	struct timespec ts;
+
+	if (end > now + HOST_SPIN_NS)
+	{
+		ts.tv_sec = (end - HOST_SPIN_NS - now) / 1000000000ull;
+		ts.tv_nsec = (long)((end - HOST_SPIN_NS - now) % 1000000000ull);
+		while (nanosleep(&ts, &ts) != 0)
+			;
+	}
+	while (monotonic_ns() < end)
+		;
+}
+
+/*************************/
+// UART
+/*************************/
+void HostBackend::uartBegin(uint8_t port, uint32_t baud)
+{
+	if ((port >= HAL_UART_COUNT) || (fds[port][0] >= 0))
+		return;
+	if (port == 0)
+	{
+		fds[0][0] = STDIN_FILENO;
+		fds[0][1] = STDOUT_FILENO;
+		fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+		return;
+	}
+
+	const char *device = getenv("MMU_SERIAL1");
+	int fd;
+
+	if (!device)
+		return;
+	fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		perror(device);
+		return;
+	}
+	if (isatty(fd))
+	{
+		struct termios tio;
+
+		tcgetattr(fd, &tio);
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	fds[port][0] = fds[port][1] = fd;
+}
+
+// read one byte ahead into pending[port], false when nothing is there
+bool HostBackend::fill(uint8_t port)
+{
+	uint8_t c;
+
+	if (port >= HAL_UART_COUNT)
+		return false;
+	if (pending[port] >= 0)
+		return true;
+	if ((fds[port][0] < 0) || (read(fds[port][0], &c, 1) != 1))
+		return false;
+	pending[port] = c;
+	return true;
+}
+
+int HostBackend::uartAvailable(uint8_t port)
+{
+	return fill(port) ? 1 : 0;
+}
+
+int HostBackend::uartRead(uint8_t port)
+{
+	int c;
+
+	if (!fill(port))
+		return -1;
+	c = pending[port];
+	pending[port] = -1;
+	return c;
+}
+
+int HostBackend::uartPeek(uint8_t port)
+{
+	return fill(port) ? pending[port] : -1;
+}
+
+int HostBackend::uartAvailableForWrite(uint8_t port)
+{
+	return 64; // write() below blocks until the byte is gone, there is always room
+}
+
+void HostBackend::uartWrite(uint8_t port, uint8_t c)
+{
+	if ((port >= HAL_UART_COUNT) || (fds[port][1] < 0))
+		return;
+	while ((write(fds[port][1], &c, 1) != 1) && (errno == EAGAIN))
+		usleep(100);
+}
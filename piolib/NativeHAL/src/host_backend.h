@@ -0,0 +1,49 @@
+#ifndef HOST_BACKEND_H
+#define HOST_BACKEND_H
+
+#include "hal.h"
+
+/*************************/
+// Real time backend for a Linux host
+//
+// Pins are kept in memory: outputs remember the last level written, inputs read
+// the level given with setInput() (INPUT_PULLUP pins read HIGH until then).
+// Serial is the terminal (stdin / stdout). Serial1 is the device or fifo named by
+// the MMU_SERIAL1 environment variable, e.g. one end of a pty pair; without it
+// nothing is received and what the firmware sends to the printer is dropped.
+/*************************/
+
+class HostBackend : public HalBackend
+{
+public:
+	HostBackend();
+
+	void pinMode(uint8_t pin, uint8_t mode) override;
+	void digitalWrite(uint8_t pin, uint8_t value) override;
+	int digitalRead(uint8_t pin) override;
+
+	uint64_t micros() override;
+	void delayMicroseconds(uint32_t us) override;
+
+	void uartBegin(uint8_t port, uint32_t baud) override;
+	int uartAvailable(uint8_t port) override;
+	int uartRead(uint8_t port) override;
+	int uartPeek(uint8_t port) override;
+	int uartAvailableForWrite(uint8_t port) override;
+	void uartWrite(uint8_t port, uint8_t c) override;
+
+	// level seen by digitalRead() on an input pin
+	void setInput(uint8_t pin, uint8_t value);
+
+private:
+	bool fill(uint8_t port);
+
+	uint8_t modes[HAL_PIN_COUNT];
+	uint8_t levels[HAL_PIN_COUNT];
+	bool inputSet[HAL_PIN_COUNT];
+	uint64_t startNs;
+	int fds[HAL_UART_COUNT][2]; // read, write
+	int pending[HAL_UART_COUNT]; // byte read ahead by available() / peek(), -1 if none
+};
+
+#endif // HOST_BACKEND_H
@@ -0,0 +1,12 @@
+#include "Arduino.h"
+
+// a simulator defines NATIVE_CUSTOM_MAIN and calls setup() / loop() from its own main()
+#ifndef NATIVE_CUSTOM_MAIN
+int main()
+{
+	setup();
+	for (;;)
+		loop();
+	return 0;
+}
+#endif